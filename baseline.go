@@ -0,0 +1,266 @@
+package main
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"path/filepath"
+	"sync"
+	"time"
+)
+
+// Each machine keeps a baseline profile of how it behaves when idle and
+// which frequencies it runs at through the day. Sessions fold what they saw
+// into it on exit, merging sketches rather than rescanning anything, and
+// compare themselves against it while running to flag drift, such as idle
+// power creeping up after an OS update.
+const (
+	stateDir = "/var/db/mactop"
+
+	idleMaxPActive   = 10 // %: a sample is idle when the P-cluster
+	idleMaxGPUActive = 5  // and the GPU are this quiet
+	baselineMaxIdle  = 1 << 20
+	driftMinSamples  = 60
+	driftPowerW      = 1.0  // idle power drift must exceed this many watts
+	driftPowerRatio  = 0.25 // and this fraction of the usual idle power
+	driftResidency   = 15.0 // percentage points of idle cluster residency
+)
+
+var (
+	baselinePath    = filepath.Join(stateDir, "baseline.json") // "" disables baselines
+	sessionBaseline *baselineTracker
+)
+
+type idleStat int
+
+const (
+	idlePowerW idleStat = iota
+	idleEActive
+	idlePActive
+	numIdleStats
+)
+
+var (
+	idleStatNames   = [numIdleStats]string{"power_w", "e_cluster_active", "p_cluster_active"}
+	idleStatLabels  = [numIdleStats]string{"power", "E-Cluster residency", "P-Cluster residency"}
+	idleStatMetrics = [numIdleStats]metricID{metricPackageW, metricEClusterActive, metricPClusterActive}
+)
+
+// machineProfile is one machine's baseline as stored on disk.
+type machineProfile struct {
+	Updated   time.Time                           `json:"updated"`
+	Sessions  int                                 `json:"sessions"`
+	Idle      map[string]*storedStat              `json:"idle"`
+	FreqTimeS [24][numFreqDomains]map[int]float64 `json:"time_at_frequency_s_by_hour"`
+}
+
+// storedStat is a runningStat with its sketch's non-empty buckets.
+type storedStat struct {
+	Count   int            `json:"count"`
+	Sum     float64        `json:"sum"`
+	Min     float64        `json:"min"`
+	Max     float64        `json:"max"`
+	Zero    uint64         `json:"zero"`
+	Buckets map[int]uint64 `json:"buckets"`
+}
+
+func storeStat(r *runningStat) *storedStat {
+	st := &storedStat{Count: r.Count, Sum: r.Sum, Min: r.Min, Max: r.Max, Zero: r.sketch.zero, Buckets: make(map[int]uint64)}
+	for i, c := range r.sketch.counts {
+		if c > 0 {
+			st.Buckets[i] = c
+		}
+	}
+	return st
+}
+
+func (st *storedStat) load(r *runningStat) {
+	*r = runningStat{Count: st.Count, Sum: st.Sum, Min: st.Min, Max: st.Max}
+	r.sketch.zero, r.sketch.total = st.Zero, st.Zero
+	for i, c := range st.Buckets {
+		if i >= 0 && i < sketchBuckets {
+			r.sketch.counts[i] = c
+			r.sketch.total += c
+		}
+	}
+}
+
+// halve ages a stat so that recent sessions outweigh old ones.
+func (r *runningStat) halve() {
+	r.Count /= 2
+	r.Sum /= 2
+	r.sketch.zero /= 2
+	r.sketch.total = r.sketch.zero
+	for i := range r.sketch.counts {
+		r.sketch.counts[i] /= 2
+		r.sketch.total += r.sketch.counts[i]
+	}
+}
+
+// baselineTracker holds the stored baseline for this machine and what the
+// current session has seen so far.
+type baselineTracker struct {
+	mu      sync.Mutex
+	path    string
+	key     string
+	base    [numIdleStats]runningStat
+	idle    [numIdleStats]runningStat
+	freq    [24][numFreqDomains]map[int]float64
+	drifted bool
+}
+
+func machineKey(model string) string {
+	host, _ := os.Hostname()
+	return model + "@" + host
+}
+
+func readBaselines(path string) (map[string]*machineProfile, error) {
+	db := make(map[string]*machineProfile)
+	data, err := os.ReadFile(path)
+	if os.IsNotExist(err) {
+		return db, nil
+	} else if err != nil {
+		return nil, err
+	}
+	if err := json.Unmarshal(data, &db); err != nil {
+		return nil, fmt.Errorf("%s: %v", path, err)
+	}
+	return db, nil
+}
+
+// loadBaseline reads this machine's baseline. A missing or unreadable
+// database starts an empty one.
+func loadBaseline(path, key string) *baselineTracker {
+	t := &baselineTracker{path: path, key: key}
+	for h := range t.freq {
+		for d := range t.freq[h] {
+			t.freq[h][d] = make(map[int]float64)
+		}
+	}
+	db, err := readBaselines(path)
+	if err != nil {
+		stderrLogger.Errorf("baseline: %v", err)
+		return t
+	}
+	if p := db[key]; p != nil {
+		for i, name := range idleStatNames {
+			if st := p.Idle[name]; st != nil {
+				st.load(&t.base[i])
+			}
+		}
+	}
+	return t
+}
+
+func (t *baselineTracker) observe(s *sample) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if s.Values[metricPClusterActive] <= idleMaxPActive && s.Values[metricGPUActive] <= idleMaxGPUActive {
+		for i, m := range idleStatMetrics {
+			t.idle[i].add(s.Values[m])
+		}
+	}
+	hour := s.Time.Hour()
+	for d, m := range freqDomainMetrics {
+		if mhz := s.Values[m]; mhz > 0 {
+			t.freq[hour][d][int(mhz/freqBucketMHz+0.5)*freqBucketMHz] += s.Elapsed
+		}
+	}
+}
+
+// drift compares this session's idle behavior with the baseline, once both
+// have enough idle samples to go on.
+func (t *baselineTracker) drift() []string {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	var out []string
+	for i := range t.idle {
+		cur, base := &t.idle[i], &t.base[i]
+		if cur.Count < driftMinSamples || base.Count < driftMinSamples {
+			continue
+		}
+		now, usual := cur.quantile(50), base.quantile(50)
+		diff := now - usual
+		switch idleStat(i) {
+		case idlePowerW:
+			if diff > driftPowerW && diff > driftPowerRatio*usual || -diff > driftPowerW && -diff > driftPowerRatio*usual {
+				out = append(out, fmt.Sprintf("Idle %s %.1f W (usual %.1f W)", idleStatLabels[i], now, usual))
+			}
+		default:
+			if diff > driftResidency || -diff > driftResidency {
+				out = append(out, fmt.Sprintf("Idle %s %.0f%% (usual %.0f%%)", idleStatLabels[i], now, usual))
+			}
+		}
+	}
+	if len(out) > 0 && !t.drifted {
+		t.drifted = true
+		for _, d := range out {
+			stderrLogger.Printf("baseline drift: %s", d)
+		}
+	}
+	return out
+}
+
+// save merges the session into the stored baseline: the database is read
+// again so concurrent sessions on other machines are kept, and replaced
+// atomically.
+func (t *baselineTracker) save() error {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	db, err := readBaselines(t.path)
+	if err != nil {
+		return err
+	}
+	p := db[t.key]
+	if p == nil {
+		p = &machineProfile{}
+		db[t.key] = p
+	}
+	if p.Idle == nil {
+		p.Idle = make(map[string]*storedStat)
+	}
+	var stored [numIdleStats]runningStat
+	for i, name := range idleStatNames {
+		if st := p.Idle[name]; st != nil {
+			st.load(&stored[i])
+		}
+	}
+	aging := stored[idlePowerW].Count > baselineMaxIdle
+	for i, name := range idleStatNames {
+		if aging {
+			stored[i].halve()
+		}
+		stored[i].merge(&t.idle[i])
+		p.Idle[name] = storeStat(&stored[i])
+	}
+	for h := range p.FreqTimeS {
+		for d := range p.FreqTimeS[h] {
+			if p.FreqTimeS[h][d] == nil {
+				p.FreqTimeS[h][d] = make(map[int]float64)
+			}
+			if aging {
+				for mhz := range p.FreqTimeS[h][d] {
+					p.FreqTimeS[h][d][mhz] /= 2
+				}
+			}
+			for mhz, secs := range t.freq[h][d] {
+				p.FreqTimeS[h][d][mhz] += secs
+			}
+		}
+	}
+	p.Sessions++
+	p.Updated = sessionClock.Now()
+
+	data, err := json.Marshal(db)
+	if err != nil {
+		return err
+	}
+	if err := os.MkdirAll(filepath.Dir(t.path), 0755); err != nil {
+		return err
+	}
+	tmp := t.path + ".tmp"
+	if err := os.WriteFile(tmp, append(data, '\n'), 0644); err != nil {
+		return err
+	}
+	return os.Rename(tmp, t.path)
+}
@@ -0,0 +1,216 @@
+package main
+
+import (
+	"fmt"
+	"os/exec"
+	"regexp"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"time"
+)
+
+// BatteryMetrics is the power source state. Remaining is negative when
+// macOS has no estimate.
+type BatteryMetrics struct {
+	Present    bool // the machine has an internal battery
+	OnAC       bool
+	Charging   bool
+	Percent    float64
+	DischargeW float64 // drawn from the battery; 0 on AC
+	Remaining  time.Duration
+}
+
+const batteryInterval = 10 * time.Second
+
+var (
+	batteryPolicy  = "auto"       // or "off": never change collection on battery
+	latestBattery  atomic.Value   // BatteryMetrics, written by sampleBatteryLoop
+	currentBattery BatteryMetrics // as last applied by the UI goroutine
+	pmsetSourceRe  = regexp.MustCompile(`Now drawing from '([^']+)'`)
+	pmsetBatteryRe = regexp.MustCompile(`InternalBattery\S*\s.*?(\d+)%;\s*([^;]+);\s*(?:(\d+):(\d+) remaining)?`)
+)
+
+// collectionPolicy is what collectMetrics asks powermetrics for.
+type collectionPolicy struct {
+	interval     int // ms
+	perProcess   bool
+	initialUsage bool // start with a sample covering the whole uptime
+}
+
+// collectorPolicy hands a new policy to collectMetrics, which restarts
+// powermetrics with it.
+var collectorPolicy = make(chan collectionPolicy, 1)
+
+func (p collectionPolicy) args() []string {
+	args := []string{"--samplers", "cpu_power,gpu_power,thermal,network,disk"}
+	if p.perProcess {
+		args = append(args, "--show-process-gpu", "--show-process-energy", "--show-process-netstats")
+	}
+	if p.initialUsage {
+		args = append(args, "--show-initial-usage")
+	}
+	return append(args, "-i", strconv.Itoa(p.interval))
+}
+
+// batteryCollectionPolicy is the policy while running on battery: half the
+// sample rate, no per-process accounting.
+func batteryCollectionPolicy() collectionPolicy {
+	return collectionPolicy{interval: max(2*updateInterval, 2000), perProcess: false}
+}
+
+// setCollectionPolicy replaces any policy collectMetrics has not picked up.
+func setCollectionPolicy(p collectionPolicy) {
+	select {
+	case <-collectorPolicy:
+	default:
+	}
+	collectorPolicy <- p
+}
+
+// sampleBatteryLoop reads the power source state whenever the scheduler
+// asks. It gives up for the session if pmset is unavailable or reports no
+// battery.
+func sampleBatteryLoop(done <-chan struct{}, request <-chan struct{}) {
+	for {
+		select {
+		case <-done:
+			return
+		case <-request:
+			b, err := readBattery()
+			if err != nil {
+				stderrLogger.Printf("battery state unavailable: %v", err)
+				return
+			}
+			latestBattery.Store(b)
+			if !b.Present {
+				return
+			}
+		}
+	}
+}
+
+func readBattery() (BatteryMetrics, error) {
+	out, err := exec.Command("pmset", "-g", "batt").Output()
+	if err != nil {
+		return BatteryMetrics{}, err
+	}
+	b := parsePmset(string(out))
+	if b.Present && !b.OnAC {
+		if out, err := exec.Command("ioreg", "-rn", "AppleSmartBattery").Output(); err == nil {
+			b.DischargeW = parseSmartBatteryW(string(out))
+		}
+	}
+	return b, nil
+}
+
+// parsePmset reads `pmset -g batt`:
+//
+//	Now drawing from 'Battery Power'
+//	 -InternalBattery-0 (id=4653155)	84%; discharging; 5:12 remaining present: true
+func parsePmset(out string) BatteryMetrics {
+	b := BatteryMetrics{OnAC: true, Remaining: -1}
+	if m := pmsetSourceRe.FindStringSubmatch(out); m != nil {
+		b.OnAC = m[1] != "Battery Power"
+	}
+	if m := pmsetBatteryRe.FindStringSubmatch(out); m != nil {
+		b.Present = true
+		b.Percent, _ = strconv.ParseFloat(m[1], 64)
+		b.Charging = strings.TrimSpace(m[2]) == "charging"
+		if m[3] != "" {
+			h, _ := strconv.Atoi(m[3])
+			mins, _ := strconv.Atoi(m[4])
+			b.Remaining = time.Duration(h)*time.Hour + time.Duration(mins)*time.Minute
+		}
+	}
+	return b
+}
+
+// parseSmartBatteryW computes the discharge rate from the AppleSmartBattery
+// registry entry: voltage in mV and current in mA, negative while
+// discharging and printed as an unsigned 64-bit number.
+func parseSmartBatteryW(out string) float64 {
+	var mV, mA int64
+	var haveInstant bool
+	for _, line := range strings.Split(out, "\n") {
+		name, value, ok := strings.Cut(strings.TrimSpace(line), " = ")
+		if !ok {
+			continue
+		}
+		u, err := strconv.ParseUint(value, 10, 64)
+		if err != nil {
+			continue
+		}
+		switch name {
+		case `"Voltage"`:
+			mV = int64(u)
+		case `"InstantAmperage"`:
+			mA, haveInstant = int64(u), true
+		case `"Amperage"`:
+			if !haveInstant {
+				mA = int64(u)
+			}
+		}
+	}
+	if mA >= 0 {
+		return 0
+	}
+	return float64(mV) * float64(-mA) / 1e6
+}
+
+// applyBattery takes the latest battery state into the UI and, when the
+// power source changed, switches the collection and render policies. It
+// runs on the UI goroutine and reports whether the screen changed; the
+// battery line itself is redrawn with the next sample.
+func applyBattery(sched *scheduler) bool {
+	b, ok := latestBattery.Load().(BatteryMetrics)
+	if !ok || !b.Present {
+		return false
+	}
+	prev := currentBattery
+	currentBattery = b
+	if batteryPolicy == "off" || (prev.Present && prev.OnAC == b.OnAC) {
+		return false
+	}
+	if !prev.Present && b.OnAC {
+		return false // started on AC: nothing to change
+	}
+	if b.OnAC {
+		stderrLogger.Printf("on AC power: restoring %d ms sampling with processes", updateInterval)
+		setCollectionPolicy(collectionPolicy{interval: updateInterval, perProcess: true})
+		sched.setPeriod("render", time.Duration(renderInterval)*time.Millisecond)
+		ProcessInfo.Title = "Process Info"
+	} else {
+		p := batteryCollectionPolicy()
+		stderrLogger.Printf("on battery: sampling every %d ms without processes", p.interval)
+		setCollectionPolicy(p)
+		sched.setPeriod("render", 2*time.Duration(renderInterval)*time.Millisecond)
+		ProcessInfo.Title = "Process Info (paused on battery)"
+	}
+	return true
+}
+
+// batteryText is the battery line for the power panel: the discharge rate
+// and what the rest of the system draws beyond the package.
+func batteryText(packageW float64) string {
+	b := currentBattery
+	if !b.Present {
+		return ""
+	}
+	if b.OnAC {
+		state := "AC"
+		if b.Charging {
+			state = "charging"
+		}
+		return fmt.Sprintf("Battery: %.0f%% (%s)", b.Percent, state)
+	}
+	s := fmt.Sprintf("Battery: %.0f%%", b.Percent)
+	if b.DischargeW > 0 {
+		s += fmt.Sprintf(", -%.1f W (rest %.1f W)", b.DischargeW, b.DischargeW-packageW)
+	}
+	if b.Remaining >= 0 {
+		mins := int(b.Remaining / time.Minute)
+		s += fmt.Sprintf(", %d:%02d left", mins/60, mins%60)
+	}
+	return s
+}
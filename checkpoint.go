@@ -0,0 +1,355 @@
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"os"
+	"os/exec"
+	"sort"
+	"strings"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// With --checkpoint the session totals (energy ledgers, metric stats and
+// sketches, time at frequency and the process heavy hitters) are kept in a
+// memory-mapped file, so a restart on the same host and boot picks the
+// session up where it left off instead of starting from zero.
+//
+// The file is a header page and two fixed-size slots. Each checkpoint is
+// encoded into the older slot, copying only the pages that changed, and
+// then the header is pointed at it; a crash mid-write leaves the previous
+// slot intact. The kernel writes dirty pages of a shared mapping back even
+// if mactop dies, and an asynchronous msync after each checkpoint bounds
+// what a power loss can take.
+const (
+	checkpointMagic    = "MTOPCKP1"
+	checkpointPage     = 4096
+	checkpointSlotSize = 1 << 20
+	checkpointSize     = checkpointPage + 2*checkpointSlotSize
+	checkpointInterval = 10 * time.Second
+	checkpointMaxFreq  = 512 // buckets per frequency domain
+)
+
+var (
+	checkpointPath    string
+	sessionCheckpoint *checkpointFile
+)
+
+type checkpointHeader struct {
+	Magic  [8]byte
+	Host   [64]byte
+	BootID [64]byte
+	Active uint32 // slot holding the latest checkpoint
+	Seq    [2]uint64
+	Len    [2]uint32
+	CRC    [2]uint32
+}
+
+type checkpointFile struct {
+	f      *os.File
+	data   []byte
+	header checkpointHeader
+	host   string
+	bootID string
+}
+
+// bootID identifies the current boot: the boot session UUID on macOS, the
+// kernel's boot_id elsewhere.
+func bootID() string {
+	if b, err := os.ReadFile("/proc/sys/kernel/random/boot_id"); err == nil {
+		return strings.TrimSpace(string(b))
+	}
+	out, err := exec.Command("sysctl", "-n", "kern.bootsessionuuid").Output()
+	if err != nil {
+		return ""
+	}
+	return strings.TrimSpace(string(out))
+}
+
+// openCheckpoint maps the checkpoint file, creating it if needed. If it
+// holds a checkpoint from this host and boot, that is restored into the
+// session totals.
+func openCheckpoint(path string) (*checkpointFile, error) {
+	f, err := os.OpenFile(path, os.O_RDWR|os.O_CREATE, 0644)
+	if err != nil {
+		return nil, err
+	}
+	if err := f.Truncate(checkpointSize); err != nil {
+		f.Close()
+		return nil, err
+	}
+	data, err := syscall.Mmap(int(f.Fd()), 0, checkpointSize, syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		f.Close()
+		return nil, err
+	}
+	c := &checkpointFile{f: f, data: data}
+	c.host, _ = os.Hostname()
+	c.bootID = bootID()
+	binary.Read(bytes.NewReader(data[:checkpointPage]), binary.LittleEndian, &c.header)
+
+	if err := c.restore(); err != nil {
+		stderrLogger.Printf("checkpoint: starting a new session: %v", err)
+		c.header = checkpointHeader{}
+	}
+	copy(c.header.Magic[:], checkpointMagic)
+	copy(c.header.Host[:], c.host)
+	copy(c.header.BootID[:], c.bootID)
+	return c, nil
+}
+
+// restore loads the active slot, or the other one if the active slot does
+// not verify, e.g. after a crash between writing a slot and its header.
+func (c *checkpointFile) restore() error {
+	h := &c.header
+	switch {
+	case string(h.Magic[:]) != checkpointMagic:
+		return errors.New("no checkpoint")
+	case cString(h.Host[:]) != c.host || c.bootID == "" || cString(h.BootID[:]) != c.bootID:
+		return errors.New("checkpoint is from another host or boot")
+	case h.Active > 1:
+		return errors.New("corrupt checkpoint header")
+	}
+	err := c.load(h.Active)
+	if err != nil && h.Seq[1-h.Active] != 0 {
+		stderrLogger.Printf("checkpoint: slot %d: %v, trying the previous one", h.Active, err)
+		if err = c.load(1 - h.Active); err == nil {
+			h.Active = 1 - h.Active
+		}
+	}
+	return err
+}
+
+func (c *checkpointFile) load(i uint32) error {
+	h := &c.header
+	if h.Len[i] > checkpointSlotSize {
+		return errors.New("corrupt checkpoint header")
+	}
+	slot := c.slot(i)[:h.Len[i]]
+	if crc32.ChecksumIEEE(slot) != h.CRC[i] {
+		return errors.New("corrupt checkpoint")
+	}
+	start, acc, recent, err := decodeCheckpoint(slot)
+	if err != nil {
+		return err
+	}
+	sessionTotals.Lock()
+	sessionTotals.start, sessionTotals.acc, sessionTotals.recent = start, acc, recent
+	sessionTotals.Unlock()
+	stderrLogger.Printf("checkpoint: resumed the session from %s, %d samples", start.Format(time.RFC3339), acc.Samples)
+	return nil
+}
+
+func (c *checkpointFile) slot(i uint32) []byte {
+	off := checkpointPage + int(i)*checkpointSlotSize
+	return c.data[off : off+checkpointSlotSize]
+}
+
+// save writes the session totals into the inactive slot and makes it the
+// active one.
+func (c *checkpointFile) save() error {
+	sessionTotals.Lock()
+	payload, err := encodeCheckpoint(sessionTotals.start, sessionTotals.acc, sessionTotals.recent)
+	sessionTotals.Unlock()
+	if err != nil {
+		return err
+	}
+	if len(payload) > checkpointSlotSize {
+		return fmt.Errorf("checkpoint of %d bytes does not fit a slot", len(payload))
+	}
+	h := &c.header
+	next := 1 - h.Active
+	if h.Seq[h.Active] == 0 && h.Seq[next] == 0 {
+		next = 0
+	}
+	copyChangedPages(c.slot(next), payload)
+	h.Seq[next] = h.Seq[h.Active] + 1
+	h.Len[next] = uint32(len(payload))
+	h.CRC[next] = crc32.ChecksumIEEE(payload)
+	h.Active = next
+	var buf bytes.Buffer
+	binary.Write(&buf, binary.LittleEndian, h)
+	copy(c.data, buf.Bytes())
+	return c.msync(syscall.MS_ASYNC)
+}
+
+// copyChangedPages copies src over dst a page at a time, skipping pages
+// that already match, so unchanged parts of the state are not dirtied.
+func copyChangedPages(dst, src []byte) {
+	for off := 0; off < len(src); off += checkpointPage {
+		end := off + checkpointPage
+		if end > len(src) {
+			end = len(src)
+		}
+		if !bytes.Equal(dst[off:end], src[off:end]) {
+			copy(dst[off:end], src[off:end])
+		}
+	}
+}
+
+func (c *checkpointFile) msync(flags int) error {
+	_, _, errno := syscall.Syscall(syscall.SYS_MSYNC, uintptr(unsafe.Pointer(&c.data[0])), uintptr(len(c.data)), uintptr(flags))
+	if errno != 0 {
+		return errno
+	}
+	return nil
+}
+
+// close takes a last checkpoint and flushes it synchronously.
+func (c *checkpointFile) close() error {
+	err := c.save()
+	if serr := c.msync(syscall.MS_SYNC); err == nil {
+		err = serr
+	}
+	syscall.Munmap(c.data)
+	c.f.Close()
+	return err
+}
+
+func cString(b []byte) string {
+	if i := bytes.IndexByte(b, 0); i >= 0 {
+		b = b[:i]
+	}
+	return string(b)
+}
+
+func encodeCheckpoint(start time.Time, acc *accumulator, recent procSketches) ([]byte, error) {
+	var buf bytes.Buffer
+	w := func(v any) { binary.Write(&buf, binary.LittleEndian, v) }
+	w(start.UnixNano())
+	w(uint16(numMetrics))
+	w(uint16(sketchBuckets))
+	w(int64(acc.Samples))
+	w(acc.Elapsed)
+	w(&acc.EnergyJ)
+	w(acc.ThrottledS)
+	for i := range acc.Stats {
+		st := &acc.Stats[i]
+		w(int64(st.Count))
+		w([3]float64{st.Sum, st.Min, st.Max})
+		w([2]uint64{st.sketch.zero, st.sketch.total})
+		w(&st.sketch.counts)
+	}
+	for _, buckets := range acc.FreqTimeS {
+		if len(buckets) > checkpointMaxFreq {
+			return nil, errors.New("too many frequency buckets")
+		}
+		w(uint32(len(buckets)))
+		mhz := make([]int, 0, len(buckets))
+		for f := range buckets {
+			mhz = append(mhz, f)
+		}
+		sort.Ints(mhz) // a stable layout leaves unchanged pages alone
+		for _, f := range mhz {
+			w(int32(f))
+			w(buckets[f])
+		}
+	}
+	for _, sketches := range []procSketches{acc.Procs, recent} {
+		for _, sk := range sketches {
+			w(int64(sk.halfLife))
+			var landmark int64
+			if !sk.landmark.IsZero() {
+				landmark = sk.landmark.UnixNano()
+			}
+			w(landmark)
+			w(uint32(len(sk.items)))
+			for _, it := range sk.items { // heap order is kept
+				w(uint16(len(it.key)))
+				buf.WriteString(it.key)
+				w([2]float64{it.count, it.err})
+			}
+		}
+	}
+	return buf.Bytes(), nil
+}
+
+func decodeCheckpoint(b []byte) (time.Time, *accumulator, procSketches, error) {
+	rd := bytes.NewReader(b)
+	var err error
+	r := func(v any) {
+		if err == nil {
+			err = binary.Read(rd, binary.LittleEndian, v)
+		}
+	}
+	var startNs, samples int64
+	var metrics, buckets uint16
+	r(&startNs)
+	r(&metrics)
+	r(&buckets)
+	if err == nil && (metrics != uint16(numMetrics) || buckets != sketchBuckets) {
+		return time.Time{}, nil, procSketches{}, fmt.Errorf("checkpoint has %d metrics and %d sketch buckets, expected %d and %d", metrics, buckets, numMetrics, sketchBuckets)
+	}
+	acc := newAccumulator()
+	r(&samples)
+	acc.Samples = int(samples)
+	r(&acc.Elapsed)
+	r(&acc.EnergyJ)
+	r(&acc.ThrottledS)
+	for i := range acc.Stats {
+		st := &acc.Stats[i]
+		var count int64
+		var f [3]float64
+		var z [2]uint64
+		r(&count)
+		r(&f)
+		r(&z)
+		r(&st.sketch.counts)
+		st.Count, st.Sum, st.Min, st.Max = int(count), f[0], f[1], f[2]
+		st.sketch.zero, st.sketch.total = z[0], z[1]
+	}
+	for d := range acc.FreqTimeS {
+		var n uint32
+		r(&n)
+		if n > checkpointMaxFreq {
+			return time.Time{}, nil, procSketches{}, errors.New("corrupt frequency table")
+		}
+		for j := uint32(0); j < n && err == nil; j++ {
+			var mhz int32
+			var secs float64
+			r(&mhz)
+			r(&secs)
+			acc.FreqTimeS[d][int(mhz)] = secs
+		}
+	}
+	recent := newProcSketches(heavyHitterHalfLife)
+	for _, sketches := range []procSketches{acc.Procs, recent} {
+		for _, sk := range sketches {
+			var halfLife, landmark int64
+			var n uint32
+			r(&halfLife)
+			r(&landmark)
+			r(&n)
+			if n > uint32(sk.cap) {
+				return time.Time{}, nil, procSketches{}, errors.New("corrupt process sketch")
+			}
+			sk.halfLife = time.Duration(halfLife)
+			if landmark != 0 {
+				sk.landmark = time.Unix(0, landmark)
+			}
+			for j := uint32(0); j < n && err == nil; j++ {
+				var l uint16
+				var v [2]float64
+				r(&l)
+				key := make([]byte, l)
+				if err == nil {
+					_, err = io.ReadFull(rd, key)
+				}
+				r(&v)
+				k := string(key)
+				sk.pos[k] = len(sk.items)
+				sk.items = append(sk.items, hhCounter{key: k, count: v[0], err: v[1]})
+			}
+		}
+	}
+	if err != nil {
+		return time.Time{}, nil, procSketches{}, err
+	}
+	return time.Unix(0, startNs), acc, recent, nil
+}
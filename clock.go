@@ -0,0 +1,146 @@
+package main
+
+import (
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// clock is the time source for session logic: sample timestamps, the
+// scheduler, power rollups, log rate limits, markers, laps, the summary and
+// recording retention. Network and file deadlines stay on the wall clock.
+type clock interface {
+	Now() time.Time
+	NewTimer(d time.Duration) clockTimer
+}
+
+type clockTimer interface {
+	C() <-chan time.Time
+	Stop() bool
+	Reset(d time.Duration) bool
+}
+
+// sessionClock is read by goroutines that start during package init (the
+// logger's flush loop), so a replay installs its clock with set rather
+// than by assignment.
+var sessionClock = newSwitchableClock(realClock{})
+
+type switchableClock struct {
+	current atomic.Pointer[clock]
+}
+
+func newSwitchableClock(c clock) *switchableClock {
+	s := &switchableClock{}
+	s.set(c)
+	return s
+}
+
+func (s *switchableClock) set(c clock) { s.current.Store(&c) }
+
+func (s *switchableClock) Now() time.Time { return (*s.current.Load()).Now() }
+
+func (s *switchableClock) NewTimer(d time.Duration) clockTimer {
+	return (*s.current.Load()).NewTimer(d)
+}
+
+// onSampleBoundary, when set, is called with each sample's elapsed time as
+// its header is read, before the sample is stamped. Replays use it to move
+// a virtual clock in step with the samples.
+var onSampleBoundary func(elapsed time.Duration)
+
+type realClock struct{}
+
+func (realClock) Now() time.Time { return time.Now() }
+
+func (realClock) NewTimer(d time.Duration) clockTimer { return realTimer{time.NewTimer(d)} }
+
+type realTimer struct{ *time.Timer }
+
+func (t realTimer) C() <-chan time.Time { return t.Timer.C }
+
+// virtualClock only moves when advanced, firing the timers that come due
+// along the way in deadline order. Like time.Timer, a virtual timer's
+// channel holds one pending tick and further ticks are dropped.
+type virtualClock struct {
+	mu     sync.Mutex
+	now    time.Time
+	timers []*virtualTimer
+}
+
+type virtualTimer struct {
+	clock *virtualClock
+	c     chan time.Time
+	when  time.Time
+	armed bool
+}
+
+func newVirtualClock(start time.Time) *virtualClock {
+	return &virtualClock{now: start}
+}
+
+func (c *virtualClock) Now() time.Time {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.now
+}
+
+func (c *virtualClock) NewTimer(d time.Duration) clockTimer {
+	t := &virtualTimer{clock: c, c: make(chan time.Time, 1)}
+	c.mu.Lock()
+	c.timers = append(c.timers, t)
+	c.mu.Unlock()
+	t.Reset(d)
+	return t
+}
+
+// Advance moves the clock forward by d.
+func (c *virtualClock) Advance(d time.Duration) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	end := c.now.Add(d)
+	for {
+		var next *virtualTimer
+		for _, t := range c.timers {
+			if t.armed && !t.when.After(end) && (next == nil || t.when.Before(next.when)) {
+				next = t
+			}
+		}
+		if next == nil {
+			break
+		}
+		if next.when.After(c.now) {
+			c.now = next.when
+		}
+		next.fireLocked()
+	}
+	c.now = end
+}
+
+func (t *virtualTimer) C() <-chan time.Time { return t.c }
+
+func (t *virtualTimer) fireLocked() {
+	t.armed = false
+	select {
+	case t.c <- t.clock.now:
+	default:
+	}
+}
+
+func (t *virtualTimer) Stop() bool {
+	t.clock.mu.Lock()
+	defer t.clock.mu.Unlock()
+	was := t.armed
+	t.armed = false
+	return was
+}
+
+func (t *virtualTimer) Reset(d time.Duration) bool {
+	t.clock.mu.Lock()
+	defer t.clock.mu.Unlock()
+	was := t.armed
+	t.when, t.armed = t.clock.now.Add(d), true
+	if d <= 0 {
+		t.fireLocked()
+	}
+	return was
+}
@@ -0,0 +1,390 @@
+// Command fake-powermetrics mimics the text output of macOS powermetrics so
+// mactop can be run end to end, through a real pipe, on machines without
+// it (or without root):
+//
+//	go build -o /tmp/fakebin/powermetrics ./cmd/fake-powermetrics
+//	PATH=/tmp/fakebin:$PATH mactop
+//
+// It accepts the powermetrics flags mactop passes (--samplers, -i, -n and
+// the --show-* options) and prints one sample per interval, with the
+// "*** Sampled system activity" header and the elapsed time jittered like
+// the real tool. Samples are synthetic unless a fixture is given.
+//
+// Built or linked as sysctl or system_profiler, it answers those instead
+// (see stubs.go).
+//
+// Fault injection is configured through the environment, since mactop's
+// command line for powermetrics is fixed:
+//
+//	FAKE_POWERMETRICS_FIXTURE  replay samples from a captured powermetrics log, cyclically
+//	FAKE_POWERMETRICS_SEED     random seed (default 1) for reproducible runs
+//	FAKE_POWERMETRICS_PARTIAL  write each sample in small random chunks with pauses
+//	FAKE_POWERMETRICS_CRASH    probability per sample of dying mid-sample with status 1
+//	FAKE_POWERMETRICS_SPEED    time multiplier, e.g. 1000 to emit 1000x faster than -i
+//	FAKE_POWERMETRICS_CHURN    probability per sample of a short-lived process appearing
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"fmt"
+	"math"
+	"math/rand"
+	"os"
+	"strconv"
+	"strings"
+	"time"
+)
+
+type options struct {
+	samplers  map[string]bool
+	interval  time.Duration
+	count     int // 0 runs until killed
+	show      map[string]bool
+	fixture   string
+	partial   bool
+	crash     float64
+	speed     float64
+	churn     float64
+	seed      int64
+	eCores    int
+	pCores    int
+	gpuStates []int
+}
+
+func main() {
+	if status, ok := runStub(); ok {
+		os.Exit(status)
+	}
+	opts, err := parseArgs(os.Args[1:])
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "powermetrics:", err)
+		os.Exit(64)
+	}
+	out := bufio.NewWriterSize(os.Stdout, 64<<10)
+	rng := rand.New(rand.NewSource(opts.seed))
+
+	var fixture [][]byte
+	if opts.fixture != "" {
+		if fixture, err = loadFixture(opts.fixture); err != nil {
+			fmt.Fprintln(os.Stderr, "powermetrics:", err)
+			os.Exit(1)
+		}
+	}
+
+	fmt.Fprintf(out, "Machine model: Mac14,6\nOS version: 23A344\nBoot arguments:\nBoot time: %s\n\n\n\n",
+		time.Now().Add(-time.Hour).Format("Mon Jan _2 15:04:05 2006"))
+	out.Flush()
+
+	sim := newSimulation(opts, rng)
+	var buf bytes.Buffer
+	for n := 0; opts.count == 0 || n < opts.count; n++ {
+		jitter := 1 + (rng.Float64()-0.5)*0.01
+		elapsed := time.Duration(float64(opts.interval) * jitter)
+		time.Sleep(time.Duration(float64(elapsed) / opts.speed))
+
+		buf.Reset()
+		fmt.Fprintf(&buf, "*** Sampled system activity (%s) (%.2fms elapsed) ***\n\n",
+			time.Now().Format("Mon Jan _2 15:04:05 2006 -0700"), float64(elapsed)/float64(time.Millisecond))
+		if fixture != nil {
+			buf.Write(fixture[n%len(fixture)])
+		} else {
+			sim.step(elapsed)
+			sim.write(&buf)
+		}
+
+		data := buf.Bytes()
+		if opts.crash > 0 && rng.Float64() < opts.crash {
+			out.Write(data[:rng.Intn(len(data))])
+			out.Flush()
+			fmt.Fprintln(os.Stderr, "powermetrics: simulated crash")
+			os.Exit(1)
+		}
+		if opts.partial {
+			for len(data) > 0 {
+				k := 1 + rng.Intn(512)
+				if k > len(data) {
+					k = len(data)
+				}
+				out.Write(data[:k])
+				out.Flush()
+				data = data[k:]
+				time.Sleep(time.Duration(rng.Intn(2000)) * time.Microsecond)
+			}
+		} else {
+			out.Write(data)
+		}
+		if err := out.Flush(); err != nil {
+			os.Exit(1) // reader went away: EPIPE, like the real tool
+		}
+	}
+}
+
+func parseArgs(args []string) (options, error) {
+	opts := options{
+		samplers:  map[string]bool{},
+		interval:  5 * time.Second, // powermetrics' default
+		show:      map[string]bool{},
+		speed:     1,
+		seed:      1,
+		eCores:    4,
+		pCores:    8,
+		gpuStates: []int{338, 618, 796, 924, 952, 1000, 1056, 1062, 1182, 1182, 1312, 1242, 1380, 1326, 1470, 1398},
+	}
+	for i := 0; i < len(args); i++ {
+		arg := args[i]
+		value := func() (string, error) {
+			if i+1 >= len(args) {
+				return "", fmt.Errorf("option %s requires an argument", arg)
+			}
+			i++
+			return args[i], nil
+		}
+		switch {
+		case arg == "--samplers" || arg == "-s":
+			v, err := value()
+			if err != nil {
+				return opts, err
+			}
+			for _, s := range strings.Split(v, ",") {
+				opts.samplers[s] = true
+			}
+		case arg == "-i" || arg == "--sample-rate":
+			v, err := value()
+			if err != nil {
+				return opts, err
+			}
+			ms, err := strconv.Atoi(v)
+			if err != nil || ms < 0 {
+				return opts, fmt.Errorf("invalid interval %q", v)
+			}
+			opts.interval = time.Duration(ms) * time.Millisecond
+		case arg == "-n" || arg == "--sample-count":
+			v, err := value()
+			if err != nil {
+				return opts, err
+			}
+			if opts.count, err = strconv.Atoi(v); err != nil || opts.count < 0 {
+				return opts, fmt.Errorf("invalid sample count %q", v)
+			}
+		case strings.HasPrefix(arg, "--show-"):
+			opts.show[strings.TrimPrefix(arg, "--show-")] = true
+		default:
+			return opts, fmt.Errorf("unrecognized option %s", arg)
+		}
+	}
+	if len(opts.samplers) == 0 {
+		for _, s := range []string{"tasks", "cpu_power", "gpu_power", "thermal", "network", "disk"} {
+			opts.samplers[s] = true
+		}
+	}
+	// mactop asks for per-process columns, which come from the tasks sampler.
+	if opts.show["process-gpu"] || opts.show["process-energy"] || opts.show["process-netstats"] {
+		opts.samplers["tasks"] = true
+	}
+
+	opts.fixture = os.Getenv("FAKE_POWERMETRICS_FIXTURE")
+	opts.partial = os.Getenv("FAKE_POWERMETRICS_PARTIAL") != ""
+	envFloat := func(name string, dst *float64) {
+		if v, err := strconv.ParseFloat(os.Getenv(name), 64); err == nil {
+			*dst = v
+		}
+	}
+	envFloat("FAKE_POWERMETRICS_CRASH", &opts.crash)
+	envFloat("FAKE_POWERMETRICS_SPEED", &opts.speed)
+	envFloat("FAKE_POWERMETRICS_CHURN", &opts.churn)
+	if opts.speed <= 0 {
+		opts.speed = 1
+	}
+	if v, err := strconv.ParseInt(os.Getenv("FAKE_POWERMETRICS_SEED"), 10, 64); err == nil {
+		opts.seed = v
+	}
+	return opts, nil
+}
+
+// loadFixture splits a captured powermetrics log into sample bodies, the
+// text after each "*** Sampled system activity" header line.
+func loadFixture(path string) ([][]byte, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	const header = "*** Sampled system activity"
+	var samples [][]byte
+	for _, part := range bytes.Split(data, []byte(header))[1:] {
+		if nl := bytes.IndexByte(part, '\n'); nl >= 0 {
+			samples = append(samples, part[nl+1:])
+		}
+	}
+	if len(samples) == 0 {
+		return nil, fmt.Errorf("%s: no samples found", path)
+	}
+	return samples, nil
+}
+
+// churnNames are the short-lived processes that come and go, each time
+// with a new PID, as during a build.
+var churnNames = []string{"clang", "ld", "git", "cc1", "swift-frontend", "xcodebuild", "mdworker_shared", "python3", "go", "compile", "link", "sh"}
+
+type process struct {
+	name   string
+	pid    int
+	weight float64 // share of CPU load
+	gpu    bool
+	ttl    int // samples left for short-lived processes, -1 forever
+}
+
+// simulation is a seeded load model: a slow random walk with occasional
+// bursts, spread over a process table with some churn.
+type simulation struct {
+	opts     options
+	rng      *rand.Rand
+	load     float64 // 0..1
+	gpuLoad  float64
+	burst    int
+	procs    []*process
+	nextPID  int
+	pressure int
+}
+
+func newSimulation(opts options, rng *rand.Rand) *simulation {
+	s := &simulation{opts: opts, rng: rng, load: 0.15, gpuLoad: 0.05, nextPID: 5000}
+	for i, name := range []string{"kernel_task", "WindowServer", "launchd", "mds_stores", "Safari",
+		"com.apple.WebKit.WebContent", "Xcode", "node", "go", "Terminal", "coreaudiod", "bluetoothd",
+		"Finder", "Dock", "Spotlight", "photoanalysisd", "cloudd", "syslogd", "Mail", "Slack"} {
+		s.procs = append(s.procs, &process{name: name, pid: 100 + i*37, weight: 1 / float64(i+2), gpu: i == 1 || i == 5, ttl: -1})
+	}
+	return s
+}
+
+func (s *simulation) step(elapsed time.Duration) {
+	s.load += (s.rng.Float64() - 0.5) * 0.08
+	if s.burst > 0 {
+		s.burst--
+	} else if s.rng.Float64() < 0.02 {
+		s.burst = 3 + s.rng.Intn(20)
+	}
+	s.load = math.Max(0.02, math.Min(0.95, s.load))
+	s.gpuLoad = math.Max(0, math.Min(1, s.gpuLoad+(s.rng.Float64()-0.5)*0.1))
+	if s.rng.Float64() < 0.01 {
+		s.pressure = s.rng.Intn(3)
+	}
+	live := s.procs[:0]
+	for _, p := range s.procs {
+		if p.ttl > 0 {
+			p.ttl--
+		}
+		if p.ttl != 0 {
+			live = append(live, p)
+		}
+	}
+	s.procs = live
+	if s.opts.churn > 0 && s.rng.Float64() < s.opts.churn {
+		s.nextPID++
+		s.procs = append(s.procs, &process{
+			name:   churnNames[s.rng.Intn(len(churnNames))],
+			pid:    s.nextPID,
+			weight: s.rng.Float64() * 0.5,
+			ttl:    1 + s.rng.Intn(30),
+		})
+	}
+}
+
+func (s *simulation) cpuLoad() float64 {
+	if s.burst > 0 {
+		return math.Min(1, s.load+0.6)
+	}
+	return s.load
+}
+
+func (s *simulation) write(b *bytes.Buffer) {
+	load := s.cpuLoad()
+	cores := s.opts.eCores + s.opts.pCores
+	if s.opts.samplers["tasks"] {
+		b.WriteString("*** Running tasks ***\n\n")
+		fmt.Fprintf(b, "%-35s %-6s %-9s %-6s %-26s %-25s", "Name", "ID", "CPU ms/s", "User%", "Deadlines (<2 ms, 2-5 ms)", "Wakeups (Intr, Pkg idle)")
+		if s.opts.show["process-gpu"] {
+			fmt.Fprintf(b, " %-9s", "GPU ms/s")
+		}
+		if s.opts.show["process-energy"] {
+			fmt.Fprintf(b, " %-14s", "Energy Impact")
+		}
+		b.WriteString("\n")
+		var allCPU, allEnergy float64
+		for _, p := range s.procs {
+			cpu := p.weight * load * float64(cores) * 1000 / 4 * (0.8 + 0.4*s.rng.Float64())
+			gpu := 0.0
+			if p.gpu {
+				gpu = s.gpuLoad * 1000 * p.weight
+			}
+			energy := cpu/10 + gpu/5
+			allCPU += cpu
+			allEnergy += energy
+			fmt.Fprintf(b, "%-35s %-6d %-9.2f %-6.2f %-12.2f %-13.2f %-12.2f %-12.2f", p.name, p.pid, cpu, 40+20*s.rng.Float64(),
+				s.rng.Float64()*10, s.rng.Float64(), s.rng.Float64()*300, s.rng.Float64()*50)
+			if s.opts.show["process-gpu"] {
+				fmt.Fprintf(b, " %-9.2f", gpu)
+			}
+			if s.opts.show["process-energy"] {
+				fmt.Fprintf(b, " %-14.2f", energy)
+			}
+			b.WriteString("\n")
+		}
+		fmt.Fprintf(b, "%-35s %-6d %-9.2f %-6.2f %-12.2f %-13.2f %-12.2f %-12.2f", "ALL_TASKS", -2, allCPU, 50.0, 0.0, 0.0, 0.0, 0.0)
+		b.WriteString("\n\n")
+	}
+	if s.opts.samplers["network"] {
+		fmt.Fprintf(b, "**** Network activity ****\n\nout: %.2f packets/s, %.2f bytes/s\nin:  %.2f packets/s, %.2f bytes/s\n\n",
+			s.rng.Float64()*200, s.rng.Float64()*200000, s.rng.Float64()*300, s.rng.Float64()*900000)
+	}
+	if s.opts.samplers["disk"] {
+		fmt.Fprintf(b, "**** Disk activity ****\n\nread: %.2f ops/s %.2f KBytes/s\nwrite: %.2f ops/s %.2f KBytes/s\n\n",
+			s.rng.Float64()*100, s.rng.Float64()*5000, s.rng.Float64()*100, s.rng.Float64()*8000)
+	}
+	var cpuMW float64
+	if s.opts.samplers["cpu_power"] {
+		b.WriteString("**** Processor usage ****\n\n")
+		cpuMW = s.writeCluster(b, "E", 0, s.opts.eCores, load*0.9, 744, 2748, 60)
+		cpuMW += s.writeCluster(b, "P", s.opts.eCores, s.opts.pCores, load*0.7, 702, 3504, 900)
+		fmt.Fprintf(b, "CPU Power: %.0f mW\n", cpuMW)
+	}
+	gpuMW := s.gpuLoad * 12000
+	if s.opts.samplers["cpu_power"] {
+		aneMW := 0.0
+		fmt.Fprintf(b, "GPU Power: %.0f mW\nANE Power: %.0f mW\nCombined Power (CPU + GPU + ANE): %.0f mW\n\n", gpuMW, aneMW, cpuMW+gpuMW+aneMW)
+	}
+	if s.opts.samplers["gpu_power"] {
+		states := s.opts.gpuStates
+		active := int(s.gpuLoad * float64(len(states)-1))
+		fmt.Fprintf(b, "**** GPU usage ****\n\nGPU HW active frequency: %d MHz\nGPU HW active residency: %6.2f%% (", states[active], s.gpuLoad*100)
+		for i, mhz := range states {
+			pct := 0.0
+			if i == active {
+				pct = s.gpuLoad * 100
+			}
+			fmt.Fprintf(b, "%d MHz: %3.0f%% ", mhz, pct)
+		}
+		fmt.Fprintf(b, ")\nGPU idle residency: %6.2f%%\nGPU Power: %.0f mW\n\n", 100-s.gpuLoad*100, gpuMW)
+	}
+	if s.opts.samplers["thermal"] {
+		fmt.Fprintf(b, "**** Thermal pressure ****\n\nCurrent pressure level: %s\n\n", []string{"Nominal", "Moderate", "Heavy"}[s.pressure])
+	}
+}
+
+// writeCluster prints one CPU cluster and returns its power in mW.
+func (s *simulation) writeCluster(b *bytes.Buffer, name string, first, n int, load float64, minMHz, maxMHz int, mwPerCore float64) float64 {
+	freq := minMHz + int(load*float64(maxMHz-minMHz))
+	fmt.Fprintf(b, "%s-Cluster HW active frequency: %d MHz\n", name, freq)
+	fmt.Fprintf(b, "%s-Cluster HW active residency: %6.2f%% (%d MHz: %3.0f%% %d MHz: %3.0f%%)\n", name, load*100, minMHz, (1-load)*100, maxMHz, load*100)
+	fmt.Fprintf(b, "%s-Cluster idle residency: %6.2f%%\n", name, 100-load*100)
+	mw := 0.0
+	for c := first; c < first+n; c++ {
+		r := math.Max(0, math.Min(1, load*(0.7+0.6*s.rng.Float64())))
+		fmt.Fprintf(b, "CPU %d frequency: %d MHz\n", c, freq)
+		fmt.Fprintf(b, "CPU %d active residency: %6.2f%% (%d MHz: %3.0f%% %d MHz: %3.0f%%)\n", c, r*100, minMHz, (1-r)*100, maxMHz, r*100)
+		fmt.Fprintf(b, "CPU %d idle residency: %6.2f%%\n", c, 100-r*100)
+		mw += r * mwPerCore * float64(freq) / float64(maxMHz)
+	}
+	b.WriteString("\n")
+	return mw
+}
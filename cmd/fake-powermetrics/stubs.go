@@ -0,0 +1,76 @@
+package main
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+)
+
+// The binary also stands in for the other commands mactop runs at startup
+// when invoked under their names, so `mactop bench-startup` can measure
+// mactop's own startup cost:
+//
+//	ln -s powermetrics /tmp/fakebin/sysctl
+//	ln -s powermetrics /tmp/fakebin/system_profiler
+//
+// The answers describe the simulated chip: 4 E-cores, 8 P-cores and a
+// 19-core GPU.
+var stubs = map[string]func(args []string) int{
+	"sysctl":          fakeSysctl,
+	"system_profiler": fakeSystemProfiler,
+}
+
+var sysctlValues = []struct{ name, value string }{
+	{"machdep.cpu.brand_string", "Apple M2 Pro"},
+	{"machdep.cpu.core_count", "12"},
+	{"machdep.cpu.logical_per_package", "12"},
+	{"machdep.cpu.thread_count", "12"},
+	{"hw.perflevel0.logicalcpu", "8"},
+	{"hw.perflevel1.logicalcpu", "4"},
+}
+
+// runStub runs the stub named like the binary, if there is one.
+func runStub() (int, bool) {
+	stub, ok := stubs[filepath.Base(os.Args[0])]
+	if !ok {
+		return 0, false
+	}
+	return stub(os.Args[1:]), true
+}
+
+// fakeSysctl prints every known value whose name equals or starts with one
+// of the arguments, in `sysctl name` format.
+func fakeSysctl(args []string) int {
+	status := 0
+	for _, arg := range args {
+		found := false
+		for _, v := range sysctlValues {
+			if v.name == arg || strings.HasPrefix(v.name, arg+".") {
+				fmt.Printf("%s: %s\n", v.name, v.value)
+				found = true
+			}
+		}
+		if !found {
+			fmt.Fprintf(os.Stderr, "sysctl: unknown oid '%s'\n", arg)
+			status = 1
+		}
+	}
+	return status
+}
+
+func fakeSystemProfiler(args []string) int {
+	fmt.Print(`Graphics/Displays:
+
+    Apple M2 Pro:
+
+      Chipset Model: Apple M2 Pro
+      Type: GPU
+      Bus: Built-In
+      Total Number of Cores: 19
+      Vendor: Apple (0x106b)
+      Metal Support: Metal 3
+
+`)
+	return 0
+}
@@ -0,0 +1,217 @@
+package main
+
+import (
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+const (
+	emitDatagramSize = 1432 // fits one Ethernet frame with IPv6 and UDP headers
+	emitStreamSize   = 64 << 10
+	emitMaxDelay     = 5 * time.Second // longest a sample waits in a batch
+	emitBuffers      = 4
+)
+
+// emitter pushes samples in StatsD or Influx line protocol. Each sample is
+// formatted once, on the collector goroutine, into the current batch
+// buffer; full batches go to a writer goroutine. When the writer falls
+// behind, samples that find no free buffer and batches that find the queue
+// full are dropped and counted, so a slow or absent receiver never holds up
+// collection.
+type emitter struct {
+	name   string
+	format func(b []byte, s *sample) []byte
+	out    io.WriteCloser
+	limit  int // batch size in bytes; one datagram for UDP
+
+	mu             sync.Mutex // observe runs on the collector, close on shutdown
+	closed         bool
+	buf            []byte
+	batchStart     time.Time
+	free, full     chan []byte
+	sent           uint64 // batches
+	droppedSamples uint64
+	droppedBatches uint64
+	failed         uint64 // batches
+	stopped        chan struct{}
+}
+
+var emitters []*emitter
+
+// newEmitter connects to target, which is a udp://host:port or
+// unixgram:///path address, or a file path that is appended to. A bare
+// host:port is taken as UDP.
+func newEmitter(name, target string, format func([]byte, *sample) []byte) (*emitter, error) {
+	var out io.WriteCloser
+	var err error
+	limit := emitDatagramSize
+	switch {
+	case strings.HasPrefix(target, "udp://"):
+		out, err = net.Dial("udp", strings.TrimPrefix(target, "udp://"))
+	case strings.HasPrefix(target, "unixgram://"):
+		out, err = net.Dial("unixgram", strings.TrimPrefix(target, "unixgram://"))
+	case strings.Contains(target, ":") && !strings.Contains(target, "/"):
+		out, err = net.Dial("udp", target)
+	default:
+		out, err = os.OpenFile(target, os.O_CREATE|os.O_WRONLY|os.O_APPEND, 0644)
+		limit = emitStreamSize
+	}
+	if err != nil {
+		return nil, fmt.Errorf("%s: %v", name, err)
+	}
+	return startEmitter(name, out, limit, format), nil
+}
+
+// startEmitter starts the writer goroutine for out, batching up to limit
+// bytes per write.
+func startEmitter(name string, out io.WriteCloser, limit int, format func([]byte, *sample) []byte) *emitter {
+	e := &emitter{
+		name:    name,
+		format:  format,
+		out:     out,
+		limit:   limit,
+		free:    make(chan []byte, emitBuffers),
+		full:    make(chan []byte, emitBuffers),
+		stopped: make(chan struct{}),
+	}
+	for i := 0; i < emitBuffers; i++ {
+		e.free <- make([]byte, 0, e.limit)
+	}
+	e.buf = <-e.free
+	go e.writeLoop()
+	return e
+}
+
+func (e *emitter) observe(s *sample) {
+	e.mu.Lock()
+	defer e.mu.Unlock()
+	if e.closed {
+		return
+	}
+	if e.buf == nil {
+		// Every buffer is queued or being written; try to get one back.
+		select {
+		case e.buf = <-e.free:
+		default:
+			atomic.AddUint64(&e.droppedSamples, 1)
+			return
+		}
+	}
+	if len(e.buf) == 0 {
+		e.batchStart = s.Time
+	}
+	mark := len(e.buf)
+	e.buf = e.format(e.buf, s)
+	if len(e.buf) > e.limit && mark > 0 {
+		// This sample overflowed the batch: ship what came before it and
+		// start the next batch with it.
+		next := e.take()
+		if next != nil {
+			next = append(next, e.buf[mark:]...)
+			e.batchStart = s.Time
+		} else {
+			atomic.AddUint64(&e.droppedSamples, 1)
+		}
+		e.send(e.buf[:mark])
+		e.buf = next
+		return
+	}
+	if len(e.buf) >= e.limit || s.Time.Sub(e.batchStart) >= emitMaxDelay {
+		e.send(e.buf)
+		e.buf = e.take()
+	}
+}
+
+// take returns a free buffer, or nil if none is available right now.
+func (e *emitter) take() []byte {
+	select {
+	case b := <-e.free:
+		return b[:0]
+	default:
+		return nil
+	}
+}
+
+func (e *emitter) send(b []byte) {
+	select {
+	case e.full <- b:
+	default:
+		atomic.AddUint64(&e.droppedBatches, 1)
+		e.free <- b[:0]
+	}
+}
+
+func (e *emitter) writeLoop() {
+	defer close(e.stopped)
+	for b := range e.full {
+		if _, err := e.out.Write(b); err != nil {
+			atomic.AddUint64(&e.failed, 1)
+			stderrLogger.Errorf("%s: %v", e.name, err)
+		} else {
+			atomic.AddUint64(&e.sent, 1)
+		}
+		e.free <- b[:0]
+	}
+}
+
+// close sends the partial batch and waits briefly for the writer.
+func (e *emitter) close() {
+	e.mu.Lock()
+	if len(e.buf) > 0 {
+		e.send(e.buf)
+		e.buf = nil
+	}
+	e.closed = true
+	close(e.full)
+	e.mu.Unlock()
+	select {
+	case <-e.stopped:
+	case <-time.After(time.Second):
+	}
+	e.out.Close()
+	stderrLogger.Printf("%s: %d batches sent, %d failed, %d dropped; %d samples dropped",
+		e.name, atomic.LoadUint64(&e.sent), atomic.LoadUint64(&e.failed), atomic.LoadUint64(&e.droppedBatches), atomic.LoadUint64(&e.droppedSamples))
+}
+
+// appendStatsD formats a sample as StatsD gauges, one line per metric.
+func appendStatsD(b []byte, s *sample) []byte {
+	for i, v := range s.Values {
+		b = append(b, "mactop."...)
+		b = append(b, metricNames[i]...)
+		b = append(b, ':')
+		b = strconv.AppendFloat(b, v, 'f', -1, 64)
+		b = append(b, "|g\n"...)
+	}
+	return b
+}
+
+var influxHostTag = func() string {
+	host, _ := os.Hostname()
+	return strings.NewReplacer(",", `\,`, "=", `\=`, " ", `\ `).Replace(host)
+}()
+
+// appendInflux formats a sample as one Influx line protocol point.
+func appendInflux(b []byte, s *sample) []byte {
+	b = append(b, "mactop,host="...)
+	b = append(b, influxHostTag...)
+	for i, v := range s.Values {
+		if i == 0 {
+			b = append(b, ' ')
+		} else {
+			b = append(b, ',')
+		}
+		b = append(b, metricNames[i]...)
+		b = append(b, '=')
+		b = strconv.AppendFloat(b, v, 'f', -1, 64)
+	}
+	b = append(b, ' ')
+	b = strconv.AppendInt(b, s.Time.UnixNano(), 10)
+	return append(b, '\n')
+}
@@ -0,0 +1,174 @@
+package main
+
+import (
+	"net"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+var emitBase = time.Date(2026, 1, 1, 10, 0, 0, 0, time.UTC)
+
+// emitSample returns sample i of a test stream: one second apart, with
+// PackageW set to i so every line can be traced back to its sample.
+func emitSample(i int) *sample {
+	s := &sample{Time: emitBase.Add(time.Duration(i) * time.Second), Elapsed: 1}
+	for m := range s.Values {
+		s.Values[m] = float64(m) + 0.125
+	}
+	s.Values[metricPackageW] = float64(i)
+	return s
+}
+
+// batchSamples returns the samples in one batch, or an error message if
+// the batch is larger than limit or holds part of a sample.
+func batchSamples(b []byte, limit int, influx bool) ([]int, string) {
+	if len(b) > limit {
+		return nil, "batch of " + strconv.Itoa(len(b)) + " bytes"
+	}
+	if len(b) == 0 || b[len(b)-1] != '\n' {
+		return nil, "batch does not end a line"
+	}
+	lines := strings.Split(string(b[:len(b)-1]), "\n")
+	var out []int
+	if influx {
+		for _, l := range lines {
+			v, ok := strings.CutPrefix(l, "mactop,host="+influxHostTag+" PackageW=")
+			if !ok || strings.Count(l, "=") != int(numMetrics)+1 {
+				return nil, "partial point " + l
+			}
+			v, _, _ = strings.Cut(v, ",")
+			i, _ := strconv.Atoi(v)
+			out = append(out, i)
+		}
+		return out, ""
+	}
+	if len(lines)%int(numMetrics) != 0 {
+		return nil, strconv.Itoa(len(lines)) + " gauges"
+	}
+	for j, l := range lines {
+		if !strings.HasPrefix(l, "mactop."+metricNames[j%int(numMetrics)]+":") {
+			return nil, "gauge out of place: " + l
+		}
+		if j%int(numMetrics) == int(metricPackageW) {
+			i, _ := strconv.Atoi(strings.TrimSuffix(strings.TrimPrefix(l, "mactop.PackageW:"), "|g"))
+			out = append(out, i)
+		}
+	}
+	return out, ""
+}
+
+func TestEmitterUDP(t *testing.T) {
+	for _, c := range []struct {
+		name   string
+		influx bool
+		format func([]byte, *sample) []byte
+	}{
+		{"statsd", false, appendStatsD},
+		{"influx", true, appendInflux},
+	} {
+		t.Run(c.name, func(t *testing.T) {
+			ln, err := net.ListenPacket("udp", "127.0.0.1:0")
+			if err != nil {
+				t.Fatal(err)
+			}
+			defer ln.Close()
+			got := make(chan []int)
+			go func() {
+				var seen []int
+				buf := make([]byte, 64<<10)
+				for {
+					ln.SetReadDeadline(time.Now().Add(time.Second))
+					n, _, err := ln.ReadFrom(buf)
+					if err != nil {
+						got <- seen
+						return
+					}
+					ids, bad := batchSamples(buf[:n], emitDatagramSize, c.influx)
+					if bad != "" {
+						t.Error(bad)
+					}
+					seen = append(seen, ids...)
+				}
+			}()
+			e, err := newEmitter(c.name, "udp://"+ln.LocalAddr().String(), c.format)
+			if err != nil {
+				t.Fatal(err)
+			}
+			const n = 300
+			for i := 0; i < n; i++ {
+				e.observe(emitSample(i))
+				time.Sleep(100 * time.Microsecond) // let the writer keep up
+			}
+			e.close()
+			seen := <-got
+			if len(seen) != n {
+				t.Fatalf("received %d samples, want %d", len(seen), n)
+			}
+			for i, id := range seen {
+				if id != i {
+					t.Fatalf("sample %d arrived as %d", i, id)
+				}
+			}
+			if e.droppedSamples != 0 || e.droppedBatches != 0 || e.failed != 0 {
+				t.Errorf("dropped %d samples, %d batches; %d failed", e.droppedSamples, e.droppedBatches, e.failed)
+			}
+		})
+	}
+}
+
+// blockedWriter holds every write until released, then records it.
+type blockedWriter struct {
+	release chan struct{}
+	mu      sync.Mutex
+	writes  [][]byte
+}
+
+func (w *blockedWriter) Write(b []byte) (int, error) {
+	<-w.release
+	w.mu.Lock()
+	w.writes = append(w.writes, append([]byte(nil), b...))
+	w.mu.Unlock()
+	return len(b), nil
+}
+
+func (w *blockedWriter) Close() error { return nil }
+
+func TestEmitterBlockedWriter(t *testing.T) {
+	w := &blockedWriter{release: make(chan struct{})}
+	e := startEmitter("statsd", w, emitDatagramSize, appendStatsD)
+	const n = 200
+	for i := 0; i < n; i++ {
+		e.observe(emitSample(i))
+	}
+	dropped := atomic.LoadUint64(&e.droppedSamples)
+	if dropped == 0 {
+		t.Fatal("no samples dropped while the writer was blocked")
+	}
+	close(w.release)
+	e.close()
+
+	// Every sample was either written, whole and in order, or counted.
+	var written []int
+	for _, b := range w.writes {
+		ids, bad := batchSamples(b, emitDatagramSize, false)
+		if bad != "" {
+			t.Fatal(bad)
+		}
+		written = append(written, ids...)
+	}
+	if e.droppedBatches != 0 {
+		t.Errorf("%d batches dropped; the queue holds every buffer", e.droppedBatches)
+	}
+	if len(written)+int(dropped) != n {
+		t.Errorf("%d samples written and %d dropped, want %d in all", len(written), dropped, n)
+	}
+	for i := 1; i < len(written); i++ {
+		if written[i] <= written[i-1] {
+			t.Fatalf("samples out of order: %v", written)
+		}
+	}
+}
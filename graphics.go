@@ -0,0 +1,374 @@
+package main
+
+import (
+	"bytes"
+	"compress/zlib"
+	"encoding/base64"
+	"fmt"
+	"image"
+	"io"
+	"math"
+	"os"
+	"strings"
+	"sync"
+	"syscall"
+	"unsafe"
+
+	ui "github.com/gizak/termui/v3"
+)
+
+type graphicsProtocol int
+
+const (
+	graphicsOff graphicsProtocol = iota
+	graphicsKitty
+	graphicsSixel
+)
+
+// detectGraphics picks a bitmap protocol for the --graphics mode. "auto"
+// only trusts the environment: querying the terminal would race termui's
+// input loop for the reply.
+func detectGraphics(mode string) graphicsProtocol {
+	switch mode {
+	case "kitty":
+		return graphicsKitty
+	case "sixel":
+		return graphicsSixel
+	case "off":
+		return graphicsOff
+	}
+	if os.Getenv("TMUX") != "" || os.Getenv("STY") != "" {
+		return graphicsOff // multiplexers need passthrough wrapping
+	}
+	term, program := os.Getenv("TERM"), os.Getenv("TERM_PROGRAM")
+	switch {
+	case os.Getenv("KITTY_WINDOW_ID") != "" || term == "xterm-kitty" || program == "WezTerm" || program == "ghostty":
+		return graphicsKitty
+	case strings.Contains(term, "sixel") || term == "foot" || term == "mlterm" || program == "iTerm.app":
+		return graphicsSixel
+	}
+	return graphicsOff
+}
+
+// cellPixelSize returns the size of one terminal cell in pixels, or zeros
+// when the terminal does not report its pixel dimensions.
+func cellPixelSize() (int, int) {
+	var ws struct{ Row, Col, Xpixel, Ypixel uint16 }
+	_, _, errno := syscall.Syscall(syscall.SYS_IOCTL, os.Stdout.Fd(), uintptr(syscall.TIOCGWINSZ), uintptr(unsafe.Pointer(&ws)))
+	if errno != 0 || ws.Row == 0 || ws.Col == 0 || ws.Xpixel == 0 || ws.Ypixel == 0 {
+		return 0, 0
+	}
+	return int(ws.Xpixel / ws.Col), int(ws.Ypixel / ws.Row)
+}
+
+var termColorsRGB = map[ui.Color][3]uint8{
+	ui.ColorBlack:   {0, 0, 0},
+	ui.ColorRed:     {205, 49, 49},
+	ui.ColorGreen:   {13, 188, 121},
+	ui.ColorYellow:  {229, 229, 16},
+	ui.ColorBlue:    {36, 114, 200},
+	ui.ColorMagenta: {188, 63, 188},
+	ui.ColorCyan:    {17, 168, 205},
+	ui.ColorWhite:   {229, 229, 229},
+}
+
+const (
+	pixelEmpty  = 0
+	pixelFill   = 1
+	pixelMarker = 2
+
+	chartTileCells = 2  // terminal columns per tile
+	chartColumnPx  = 2  // pixel columns per sample
+	chartMaxTiles  = 64 // tiles of history kept for redraws
+)
+
+// chartTile is a fixed-width slice of the chart. Once a tile is full it
+// never changes again, so its encoding (and, with kitty, the image already
+// held by the terminal) is reused on every frame. Only the newest tile is
+// rasterized and re-encoded as samples arrive, one column at a time.
+type chartTile struct {
+	id      uint32
+	pix     []uint8 // widthPx*heightPx mask of pixel* values
+	drawn   int     // samples rasterized into pix
+	encoded []byte  // sixel encoding, or zlib-compressed RGBA for kitty
+	dirty   bool    // encoded is out of date
+	sent    bool    // kitty: the terminal holds the current image
+}
+
+// pixelChart draws a scrolling filled line chart as a bitmap on terminals
+// that support the kitty graphics protocol or sixel.
+type pixelChart struct {
+	mu           sync.Mutex
+	proto        graphicsProtocol
+	cellW, cellH int
+	widthPx      int // per tile
+	heightPx     int
+	perTile      int // samples per tile
+	values       []float64
+	marks        []bool
+	base         int // absolute sample index of values[0]
+	tiles        map[int]*chartTile
+	scale        float64
+	nextID       uint32
+	fill, marker [3]uint8
+	deletes      []uint32 // kitty images to free on the next draw
+	visible      bool
+}
+
+// newPixelChart returns nil when bitmap charts are unavailable, in which
+// case callers keep using the character-cell charts.
+func newPixelChart(proto graphicsProtocol, color ui.Color) *pixelChart {
+	if proto == graphicsOff {
+		return nil
+	}
+	cellW, cellH := cellPixelSize()
+	if cellW == 0 {
+		if proto == graphicsSixel {
+			return nil // sixel needs exact pixel sizes
+		}
+		cellW, cellH = 10, 20 // kitty scales images to the cell box it is given
+	}
+	c := &pixelChart{
+		proto:   proto,
+		cellW:   cellW,
+		cellH:   cellH,
+		widthPx: chartTileCells * cellW,
+		tiles:   make(map[int]*chartTile),
+		fill:    termColorsRGB[ui.ColorGreen],
+		marker:  termColorsRGB[ui.ColorWhite],
+		nextID:  1,
+	}
+	if rgb, ok := termColorsRGB[color]; ok {
+		c.fill = rgb
+	}
+	if c.fill == c.marker {
+		c.marker = termColorsRGB[ui.ColorYellow]
+	}
+	c.perTile = c.widthPx / chartColumnPx
+	return c
+}
+
+func (c *pixelChart) add(v float64, marked bool) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	c.values = append(c.values, v)
+	c.marks = append(c.marks, marked)
+	if len(c.values) > (chartMaxTiles+1)*c.perTile {
+		// Drop the oldest whole tile.
+		oldest := c.base / c.perTile
+		if t := c.tiles[oldest]; t != nil {
+			c.deletes = append(c.deletes, t.id)
+			delete(c.tiles, oldest)
+		}
+		n := copy(c.values, c.values[c.perTile:])
+		c.values = c.values[:n]
+		copy(c.marks, c.marks[c.perTile:])
+		c.marks = c.marks[:n]
+		c.base += c.perTile
+	}
+	if s := niceCeil(v); s > c.scale {
+		c.scale = s
+		c.invalidate()
+	}
+}
+
+// invalidate forces every tile to be rasterized again, e.g. after the
+// vertical scale or the chart height changed.
+func (c *pixelChart) invalidate() {
+	for _, t := range c.tiles {
+		t.pix = nil
+		t.drawn = 0
+		t.dirty = true
+	}
+}
+
+// niceCeil rounds v up to 1, 2 or 5 times a power of ten.
+func niceCeil(v float64) float64 {
+	if v <= 1 {
+		return 1
+	}
+	p := math.Pow(10, math.Floor(math.Log10(v)))
+	for _, m := range []float64{1, 2, 5, 10} {
+		if v <= m*p {
+			return m * p
+		}
+	}
+	return 10 * p
+}
+
+// raster draws the samples of tile n that are not in its bitmap yet.
+func (c *pixelChart) raster(n int, t *chartTile) {
+	if t.pix == nil {
+		t.pix = make([]uint8, c.widthPx*c.heightPx)
+	}
+	start := n*c.perTile - c.base
+	for i := t.drawn; i < c.perTile && start+i < len(c.values); i++ {
+		if start+i < 0 {
+			continue
+		}
+		v, marked := c.values[start+i], c.marks[start+i]
+		h := int(math.Round(v / c.scale * float64(c.heightPx)))
+		for x := i * chartColumnPx; x < (i+1)*chartColumnPx; x++ {
+			for y := 0; y < c.heightPx; y++ {
+				px := uint8(pixelEmpty)
+				if marked {
+					px = pixelMarker
+				} else if y >= c.heightPx-h {
+					px = pixelFill
+				}
+				t.pix[y*c.widthPx+x] = px
+			}
+		}
+		t.drawn = i + 1
+		t.dirty = true
+	}
+}
+
+// draw writes the chart into the cell rectangle rect. Call it after the
+// grid has been rendered.
+func (c *pixelChart) draw(out io.Writer, rect image.Rectangle) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	var buf bytes.Buffer
+	buf.WriteString("\x1b7") // save cursor
+	for _, id := range c.deletes {
+		fmt.Fprintf(&buf, "\x1b_Ga=d,d=I,i=%d,q=2\x1b\\", id)
+	}
+	c.deletes = c.deletes[:0]
+	if h := rect.Dy() * c.cellH; h != c.heightPx {
+		c.heightPx = h
+		c.invalidate()
+	}
+	if len(c.values) == 0 || rect.Dx() < chartTileCells || rect.Dy() < 1 {
+		buf.WriteString("\x1b8")
+		out.Write(buf.Bytes())
+		return
+	}
+	last := (c.base + len(c.values) - 1) / c.perTile
+	first := last - rect.Dx()/chartTileCells + 1
+	if oldest := c.base / c.perTile; first < oldest {
+		first = oldest
+	}
+	for n := first; n <= last; n++ {
+		t := c.tiles[n]
+		if t == nil {
+			t = &chartTile{id: c.nextID}
+			c.nextID++
+			c.tiles[n] = t
+		}
+		c.raster(n, t)
+		if t.dirty {
+			t.encoded = c.encode(t)
+			t.dirty = false
+			t.sent = false
+		}
+		col := rect.Max.X - (last-n+1)*chartTileCells
+		fmt.Fprintf(&buf, "\x1b[%d;%dH", rect.Min.Y+1, col+1)
+		c.emit(&buf, t, rect.Dy())
+	}
+	buf.WriteString("\x1b8") // restore cursor
+	out.Write(buf.Bytes())
+	c.visible = true
+}
+
+// hide removes kitty placements while a full-screen view covers the grid.
+func (c *pixelChart) hide(out io.Writer) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.visible && c.proto == graphicsKitty {
+		io.WriteString(out, "\x1b_Ga=d,d=a,q=2\x1b\\")
+	}
+	c.visible = false
+}
+
+func (c *pixelChart) encode(t *chartTile) []byte {
+	if c.proto == graphicsSixel {
+		return encodeSixel(t.pix, c.widthPx, c.heightPx, c.fill, c.marker)
+	}
+	rgba := make([]byte, 4*len(t.pix))
+	for i, px := range t.pix {
+		switch px {
+		case pixelFill:
+			copy(rgba[4*i:], []byte{c.fill[0], c.fill[1], c.fill[2], 255})
+		case pixelMarker:
+			copy(rgba[4*i:], []byte{c.marker[0], c.marker[1], c.marker[2], 255})
+		}
+	}
+	var z bytes.Buffer
+	zw := zlib.NewWriter(&z)
+	zw.Write(rgba)
+	zw.Close()
+	return z.Bytes()
+}
+
+func (c *pixelChart) emit(buf *bytes.Buffer, t *chartTile, rows int) {
+	if c.proto == graphicsSixel {
+		buf.Write(t.encoded)
+		return
+	}
+	if t.sent {
+		// The terminal still has this image; just move its placement.
+		fmt.Fprintf(buf, "\x1b_Ga=p,i=%d,p=1,c=%d,r=%d,C=1,q=2\x1b\\", t.id, chartTileCells, rows)
+		return
+	}
+	payload := base64.StdEncoding.EncodeToString(t.encoded)
+	for i := 0; i < len(payload); i += 4096 {
+		end := i + 4096
+		more := 1
+		if end >= len(payload) {
+			end, more = len(payload), 0
+		}
+		if i == 0 {
+			fmt.Fprintf(buf, "\x1b_Ga=T,f=32,o=z,s=%d,v=%d,i=%d,p=1,c=%d,r=%d,C=1,q=2,m=%d;%s\x1b\\",
+				c.widthPx, c.heightPx, t.id, chartTileCells, rows, more, payload[i:end])
+		} else {
+			fmt.Fprintf(buf, "\x1b_Gm=%d;%s\x1b\\", more, payload[i:end])
+		}
+	}
+	t.sent = true
+}
+
+// encodeSixel encodes a two-colour mask as a sixel image whose empty
+// pixels stay transparent.
+func encodeSixel(pix []uint8, w, h int, fill, marker [3]uint8) []byte {
+	var buf bytes.Buffer
+	fmt.Fprintf(&buf, "\x1bP0;1;0q\"1;1;%d;%d", w, h)
+	for i, rgb := range [][3]uint8{fill, marker} {
+		fmt.Fprintf(&buf, "#%d;2;%d;%d;%d", i+1, int(rgb[0])*100/255, int(rgb[1])*100/255, int(rgb[2])*100/255)
+	}
+	for band := 0; band < h; band += 6 {
+		for color := uint8(pixelFill); color <= pixelMarker; color++ {
+			fmt.Fprintf(&buf, "#%d", color)
+			run, prev := 0, byte(0)
+			flush := func() {
+				if run > 3 {
+					fmt.Fprintf(&buf, "!%d%c", run, prev)
+				} else {
+					for ; run > 0; run-- {
+						buf.WriteByte(prev)
+					}
+				}
+				run = 0
+			}
+			for x := 0; x < w; x++ {
+				bits := byte(0)
+				for k := 0; k < 6 && band+k < h; k++ {
+					if pix[(band+k)*w+x] == color {
+						bits |= 1 << k
+					}
+				}
+				ch := 63 + bits
+				if ch != prev && run > 0 {
+					flush()
+				}
+				prev = ch
+				run++
+			}
+			flush()
+			buf.WriteByte('$')
+		}
+		buf.WriteByte('-')
+	}
+	buf.WriteString("\x1b\\")
+	return buf.Bytes()
+}
@@ -0,0 +1,45 @@
+package main
+
+import (
+	"encoding/json"
+	"os"
+	"path/filepath"
+)
+
+// hardwareProfile caches the parts of getSOCInfo that are slow to learn:
+// system_profiler takes seconds to count GPU cores. It is keyed by what the
+// sysctls report, so moving the disk to another Mac refreshes it.
+type hardwareProfile struct {
+	Name      string `json:"name"`
+	CoreCount string `json:"core_count"`
+	ECores    int    `json:"e_core_count"`
+	PCores    int    `json:"p_core_count"`
+	GPUCores  string `json:"gpu_core_count"`
+}
+
+var hardwarePath = filepath.Join(stateDir, "hardware.json")
+
+func readHardwareCache() (hardwareProfile, bool) {
+	var h hardwareProfile
+	data, err := os.ReadFile(hardwarePath)
+	if err != nil || json.Unmarshal(data, &h) != nil || h.Name == "" {
+		return h, false
+	}
+	return h, true
+}
+
+func writeHardwareCache(h hardwareProfile) {
+	data, err := json.Marshal(h)
+	if err == nil {
+		err = os.MkdirAll(filepath.Dir(hardwarePath), 0755)
+	}
+	if err == nil {
+		tmp := hardwarePath + ".tmp"
+		if err = os.WriteFile(tmp, append(data, '\n'), 0644); err == nil {
+			err = os.Rename(tmp, hardwarePath)
+		}
+	}
+	if err != nil {
+		stderrLogger.Errorf("hardware cache: %v", err)
+	}
+}
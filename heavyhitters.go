@@ -0,0 +1,135 @@
+package main
+
+import (
+	"math"
+	"sort"
+	"time"
+)
+
+// spaceSaving is a weighted Space-Saving heavy-hitters sketch: it tracks at
+// most cap keys in fixed memory however many distinct keys it sees. A new
+// key takes over the smallest counter and inherits its count as error, so
+// each reported total overstates the true one by at most its Error, and any
+// key holding more than 1/cap of the total weight is always reported.
+//
+// With a half-life the sketch weighs recent additions more, for a decayed
+// window: weights are scaled up over time (forward decay) rather than
+// decaying every counter on each add, and rescaled when the factor grows
+// large.
+type spaceSaving struct {
+	cap      int
+	items    []hhCounter // min-heap by count
+	pos      map[string]int
+	halfLife time.Duration
+	landmark time.Time
+}
+
+type hhCounter struct {
+	key        string
+	count, err float64
+}
+
+const (
+	heavyHitterCap      = 256
+	heavyHitterHalfLife = 30 * time.Minute
+)
+
+func newSpaceSaving(capacity int, halfLife time.Duration) *spaceSaving {
+	return &spaceSaving{cap: capacity, pos: make(map[string]int, capacity), halfLife: halfLife}
+}
+
+func (s *spaceSaving) add(key string, w float64, t time.Time) {
+	if w <= 0 {
+		return
+	}
+	if s.halfLife > 0 {
+		if s.landmark.IsZero() {
+			s.landmark = t
+		}
+		f := s.factor(t)
+		if f > 1<<40 {
+			for i := range s.items {
+				s.items[i].count /= f
+				s.items[i].err /= f
+			}
+			s.landmark, f = t, 1
+		}
+		w *= f
+	}
+	if i, ok := s.pos[key]; ok {
+		s.items[i].count += w
+		s.down(i)
+		return
+	}
+	if len(s.items) < s.cap {
+		s.items = append(s.items, hhCounter{key: key, count: w})
+		s.pos[key] = len(s.items) - 1
+		s.up(len(s.items) - 1)
+		return
+	}
+	min := &s.items[0]
+	delete(s.pos, min.key)
+	*min = hhCounter{key: key, count: min.count + w, err: min.count}
+	s.pos[key] = 0
+	s.down(0)
+}
+
+// factor is the forward-decay weight of time t relative to the landmark.
+func (s *spaceSaving) factor(t time.Time) float64 {
+	return math.Exp2(float64(t.Sub(s.landmark)) / float64(s.halfLife))
+}
+
+// top returns the n heaviest keys as of now, largest first.
+func (s *spaceSaving) top(n int, now time.Time) []processTotal {
+	scale := 1.0
+	if s.halfLife > 0 && !s.landmark.IsZero() {
+		scale = 1 / s.factor(now)
+	}
+	out := make([]processTotal, 0, len(s.items))
+	for _, c := range s.items {
+		out = append(out, processTotal{Name: c.key, Value: c.count * scale, Error: c.err * scale})
+	}
+	sort.Slice(out, func(i, j int) bool { return out[i].Value > out[j].Value })
+	if len(out) > n {
+		out = out[:n]
+	}
+	return out
+}
+
+func (s *spaceSaving) len() int {
+	return len(s.items)
+}
+
+func (s *spaceSaving) swap(i, j int) {
+	s.items[i], s.items[j] = s.items[j], s.items[i]
+	s.pos[s.items[i].key] = i
+	s.pos[s.items[j].key] = j
+}
+
+func (s *spaceSaving) up(i int) {
+	for i > 0 {
+		parent := (i - 1) / 2
+		if s.items[parent].count <= s.items[i].count {
+			return
+		}
+		s.swap(i, parent)
+		i = parent
+	}
+}
+
+func (s *spaceSaving) down(i int) {
+	for {
+		least, l, r := i, 2*i+1, 2*i+2
+		if l < len(s.items) && s.items[l].count < s.items[least].count {
+			least = l
+		}
+		if r < len(s.items) && s.items[r].count < s.items[least].count {
+			least = r
+		}
+		if least == i {
+			return
+		}
+		s.swap(i, least)
+		i = least
+	}
+}
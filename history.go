@@ -0,0 +1,169 @@
+package main
+
+import (
+	"math"
+	"sort"
+	"sync"
+	"time"
+)
+
+type metricID int
+
+const (
+	metricPackageW metricID = iota
+	metricCPUW
+	metricGPUW
+	metricANEW
+	metricEClusterActive
+	metricEClusterFreqMHz
+	metricPClusterActive
+	metricPClusterFreqMHz
+	metricGPUActive
+	metricGPUFreqMHz
+	metricMemUsed
+	metricSwapUsed
+	metricThermalPressure
+	numMetrics
+)
+
+var metricNames = [numMetrics]string{
+	"PackageW",
+	"CPUW",
+	"GPUW",
+	"ANEW",
+	"EClusterActive",
+	"EClusterFreqMHz",
+	"PClusterActive",
+	"PClusterFreqMHz",
+	"GPUActive",
+	"GPUFreqMHz",
+	"MemUsedBytes",
+	"SwapUsedBytes",
+	"ThermalPressure",
+}
+
+// powerRails are the metrics measured in watts, in the order summaries print them.
+var powerRails = []metricID{metricPackageW, metricCPUW, metricGPUW, metricANEW}
+
+func metricByName(name string) (metricID, bool) {
+	for i, n := range metricNames {
+		if n == name {
+			return metricID(i), true
+		}
+	}
+	return 0, false
+}
+
+// sampleValues flattens one powermetrics sample into the history columns.
+func sampleValues(cpuMetrics CPUMetrics, gpuMetrics GPUMetrics) [numMetrics]float64 {
+	var v [numMetrics]float64
+	v[metricPackageW] = cpuMetrics.PackageW
+	v[metricCPUW] = cpuMetrics.CPUW
+	v[metricGPUW] = cpuMetrics.GPUW
+	v[metricANEW] = cpuMetrics.ANEW
+	v[metricEClusterActive] = float64(cpuMetrics.EClusterActive)
+	v[metricEClusterFreqMHz] = float64(cpuMetrics.EClusterFreqMHz)
+	v[metricPClusterActive] = float64(cpuMetrics.PClusterActive)
+	v[metricPClusterFreqMHz] = float64(cpuMetrics.PClusterFreqMHz)
+	v[metricGPUActive] = gpuMetrics.Active
+	v[metricGPUFreqMHz] = float64(gpuMetrics.FreqMHz)
+	return v
+}
+
+// history is a fixed-capacity ring of per-sample metrics. Values are stored
+// column-wise so range scans over one metric walk a contiguous []float64.
+type history struct {
+	mu      sync.RWMutex
+	times   []int64   // unix nanoseconds at the end of each sample
+	elapsed []float64 // seconds covered by each sample, as reported by powermetrics
+	cols    [numMetrics][]float64
+	head    int // next slot to write
+	n       int
+}
+
+func newHistory(capacity int) *history {
+	h := &history{
+		times:   make([]int64, capacity),
+		elapsed: make([]float64, capacity),
+	}
+	for i := range h.cols {
+		h.cols[i] = make([]float64, capacity)
+	}
+	return h
+}
+
+func (h *history) append(s *sample) {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	h.times[h.head] = s.Time.UnixNano()
+	h.elapsed[h.head] = s.Elapsed
+	for i := range h.cols {
+		h.cols[i][h.head] = s.Values[i]
+	}
+	h.head = (h.head + 1) % len(h.times)
+	if h.n < len(h.times) {
+		h.n++
+	}
+}
+
+// slot maps a logical index (0 = oldest retained sample) to a ring slot.
+func (h *history) slot(i int) int {
+	return (h.head - h.n + i + len(h.times)) % len(h.times)
+}
+
+// span returns the logical index range [lo, hi) of samples with from <= t <= to.
+// Callers must hold h.mu.
+func (h *history) span(from, to time.Time) (int, int) {
+	f, t := from.UnixNano(), to.UnixNano()
+	lo := sort.Search(h.n, func(i int) bool { return h.times[h.slot(i)] >= f })
+	hi := sort.Search(h.n, func(i int) bool { return h.times[h.slot(i)] > t })
+	return lo, hi
+}
+
+// rangeSummary describes the samples recorded between two points in time.
+type rangeSummary struct {
+	From, To time.Time
+	Samples  int
+	EnergyJ  [numMetrics]float64 // only set for powerRails
+	MeanW    float64
+	P50W     float64
+	P95W     float64
+	MaxW     float64
+}
+
+func (h *history) summarize(from, to time.Time) rangeSummary {
+	h.mu.RLock()
+	defer h.mu.RUnlock()
+	s := rangeSummary{From: from, To: to}
+	lo, hi := h.span(from, to)
+	if hi <= lo {
+		return s
+	}
+	s.Samples = hi - lo
+	for _, rail := range powerRails {
+		s.EnergyJ[rail] = h.energy(rail, lo, hi)
+	}
+	a, b := h.segments(h.cols[metricPackageW], lo, hi)
+	pkg := append(append(make([]float64, 0, s.Samples), a...), b...)
+	s.MeanW = sumFloat64(pkg) / float64(len(pkg))
+	sort.Float64s(pkg)
+	s.P50W = percentileSorted(pkg, 50)
+	s.P95W = percentileSorted(pkg, 95)
+	s.MaxW = pkg[len(pkg)-1]
+	return s
+}
+
+// percentileSorted returns the nearest-rank percentile p (0-100) of sorted values.
+func percentileSorted(sorted []float64, p float64) float64 {
+	if len(sorted) == 0 {
+		return 0
+	}
+	rank := int(math.Ceil(p/100*float64(len(sorted)))) - 1
+	if rank < 0 {
+		rank = 0
+	}
+	if rank >= len(sorted) {
+		rank = len(sorted) - 1
+	}
+	return sorted[rank]
+}
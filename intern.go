@@ -0,0 +1,80 @@
+package main
+
+import (
+	"strings"
+	"sync"
+)
+
+// internTable keeps one copy of each process name. The parser looks names
+// up straight from the scanner buffer, so a name seen before costs no
+// allocation, and every sample that mentions it shares that copy; equal
+// interned names also compare by pointer. Names unseen for internMaxAge
+// samples are evicted once the table is full; if everything is recent, new
+// names are copied without being interned, so the table stays bounded no
+// matter how many processes come and go.
+const (
+	internMaxNames = 8192
+	internMaxAge   = 3600 // samples
+)
+
+type internEntry struct {
+	name string
+	seen uint32 // generation
+}
+
+type internTable struct {
+	mu    sync.Mutex
+	names map[string]*internEntry
+	gen   uint32
+	full  uint32 // generation + 1 of the last sweep that freed nothing
+}
+
+var processNames = newInternTable()
+
+func newInternTable() *internTable {
+	return &internTable{names: make(map[string]*internEntry)}
+}
+
+// tick starts a new generation; the parser calls it once per sample.
+func (t *internTable) tick() {
+	t.mu.Lock()
+	t.gen++
+	t.mu.Unlock()
+}
+
+// intern returns the shared copy of s. s may alias a buffer that is about to
+// be reused.
+func (t *internTable) intern(s string) string {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if e, ok := t.names[s]; ok {
+		e.seen = t.gen
+		return e.name
+	}
+	if len(t.names) >= internMaxNames && !t.evict() {
+		return strings.Clone(s)
+	}
+	e := &internEntry{name: strings.Clone(s), seen: t.gen}
+	t.names[e.name] = e
+	return e.name
+}
+
+// evict drops the names not seen for internMaxAge generations and reports
+// whether that made room. Samples still holding an evicted name keep their
+// copy; the next mention just interns a new one. A table full of recent
+// names is swept at most once per generation.
+func (t *internTable) evict() bool {
+	if t.full == t.gen+1 {
+		return false
+	}
+	for name, e := range t.names {
+		if t.gen-e.seen > internMaxAge {
+			delete(t.names, name)
+		}
+	}
+	if len(t.names) >= internMaxNames {
+		t.full = t.gen + 1
+		return false
+	}
+	return true
+}
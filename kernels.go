@@ -0,0 +1,119 @@
+package main
+
+// Reduction kernels for long runs of samples: the history ring, recording
+// columns and chart buffers. Each is unrolled by four with independent
+// accumulators, which breaks the loop-carried dependency on a single sum or
+// comparison, and walks its input by re-slicing so the loops carry no
+// bounds checks. Scans over days of samples are then limited by memory
+// bandwidth rather than loop overhead; kernels_test.go benchmarks them
+// against plain loops.
+//
+// Unrolled sums add in a different order than a plain loop and may differ
+// from one in the last bits.
+
+// aggregate is the min, max, sum and count of a run of values.
+type aggregate struct {
+	n             int
+	sum, min, max float64
+}
+
+// sumFloat64 returns the sum of x.
+func sumFloat64(x []float64) float64 {
+	var s0, s1, s2, s3 float64
+	for len(x) >= 4 {
+		s0 += x[0]
+		s1 += x[1]
+		s2 += x[2]
+		s3 += x[3]
+		x = x[4:]
+	}
+	for _, v := range x {
+		s0 += v
+	}
+	return (s0 + s1) + (s2 + s3)
+}
+
+// dotFloat64 returns the sum of x[i]*w[i], e.g. power times elapsed time
+// for energy. w must be at least as long as x.
+func dotFloat64(x, w []float64) float64 {
+	w = w[:len(x)]
+	var s0, s1, s2, s3 float64
+	for len(x) >= 4 && len(w) >= 4 {
+		s0 += x[0] * w[0]
+		s1 += x[1] * w[1]
+		s2 += x[2] * w[2]
+		s3 += x[3] * w[3]
+		x, w = x[4:], w[4:]
+	}
+	w = w[:len(x)] // tells the compiler the tail indexes are in range
+	for i := range x {
+		s0 += x[i] * w[i]
+	}
+	return (s0 + s1) + (s2 + s3)
+}
+
+// reduceFloat64 returns the aggregate of x in a single pass.
+func reduceFloat64(x []float64) aggregate {
+	a := aggregate{n: len(x)}
+	if len(x) == 0 {
+		return a
+	}
+	var s0, s1, s2, s3 float64
+	lo0, lo1, lo2, lo3 := x[0], x[0], x[0], x[0]
+	hi0, hi1, hi2, hi3 := x[0], x[0], x[0], x[0]
+	for len(x) >= 4 {
+		v0, v1, v2, v3 := x[0], x[1], x[2], x[3]
+		s0 += v0
+		s1 += v1
+		s2 += v2
+		s3 += v3
+		lo0, hi0 = minFloat64(lo0, v0), maxFloat64(hi0, v0)
+		lo1, hi1 = minFloat64(lo1, v1), maxFloat64(hi1, v1)
+		lo2, hi2 = minFloat64(lo2, v2), maxFloat64(hi2, v2)
+		lo3, hi3 = minFloat64(lo3, v3), maxFloat64(hi3, v3)
+		x = x[4:]
+	}
+	for _, v := range x {
+		s0 += v
+		lo0, hi0 = minFloat64(lo0, v), maxFloat64(hi0, v)
+	}
+	a.sum = (s0 + s1) + (s2 + s3)
+	a.min = minFloat64(minFloat64(lo0, lo1), minFloat64(lo2, lo3))
+	a.max = maxFloat64(maxFloat64(hi0, hi1), maxFloat64(hi2, hi3))
+	return a
+}
+
+func minFloat64(a, b float64) float64 {
+	if b < a {
+		return b
+	}
+	return a
+}
+
+func maxFloat64(a, b float64) float64 {
+	if b > a {
+		return b
+	}
+	return a
+}
+
+// segments returns the ring slots holding logical indexes [lo, hi) as at
+// most two contiguous runs of col, oldest first. Callers must hold h.mu.
+func (h *history) segments(col []float64, lo, hi int) (a, b []float64) {
+	if hi <= lo {
+		return nil, nil
+	}
+	start, end := h.slot(lo), h.slot(hi-1)+1
+	if start < end {
+		return col[start:end], nil
+	}
+	return col[start:], col[:end]
+}
+
+// energy returns the integral of one metric over logical indexes [lo, hi):
+// each value times the seconds its sample covered. Callers must hold h.mu.
+func (h *history) energy(id metricID, lo, hi int) float64 {
+	va, vb := h.segments(h.cols[id], lo, hi)
+	ea, eb := h.segments(h.elapsed, lo, hi)
+	return dotFloat64(va, ea) + dotFloat64(vb, eb)
+}
@@ -0,0 +1,105 @@
+package main
+
+import (
+	"fmt"
+	"math"
+	"math/rand"
+	"testing"
+)
+
+func randomFloats(n int, seed int64) []float64 {
+	r := rand.New(rand.NewSource(seed))
+	x := make([]float64, n)
+	for i := range x {
+		x[i] = r.Float64() * 40
+	}
+	return x
+}
+
+func naiveSum(x []float64) float64 {
+	var s float64
+	for _, v := range x {
+		s += v
+	}
+	return s
+}
+
+func naiveDot(x, w []float64) float64 {
+	var s float64
+	for i, v := range x {
+		s += v * w[i]
+	}
+	return s
+}
+
+func naiveReduce(x []float64) aggregate {
+	a := aggregate{n: len(x)}
+	for i, v := range x {
+		a.sum += v
+		if i == 0 || v < a.min {
+			a.min = v
+		}
+		if i == 0 || v > a.max {
+			a.max = v
+		}
+	}
+	return a
+}
+
+func closeTo(a, b float64) bool {
+	return math.Abs(a-b) <= 1e-9*math.Max(1, math.Abs(b))
+}
+
+func TestKernels(t *testing.T) {
+	for _, n := range []int{0, 1, 3, 4, 5, 7, 8, 1001} {
+		x, w := randomFloats(n, 1), randomFloats(n+2, 2)
+		if got, want := sumFloat64(x), naiveSum(x); !closeTo(got, want) {
+			t.Errorf("n=%d: sum %v, want %v", n, got, want)
+		}
+		if got, want := dotFloat64(x, w), naiveDot(x, w); !closeTo(got, want) {
+			t.Errorf("n=%d: dot %v, want %v", n, got, want)
+		}
+		got, want := reduceFloat64(x), naiveReduce(x)
+		if got.n != want.n || got.min != want.min || got.max != want.max || !closeTo(got.sum, want.sum) {
+			t.Errorf("n=%d: reduce %+v, want %+v", n, got, want)
+		}
+	}
+}
+
+var kernelSink float64
+
+func benchmarkKernel(b *testing.B, f func(x, w []float64) float64) {
+	for _, n := range []int{4 << 10, 1 << 20} {
+		x, w := randomFloats(n, 1), randomFloats(n, 2)
+		b.Run(fmt.Sprint(n), func(b *testing.B) {
+			b.SetBytes(int64(8 * n))
+			for i := 0; i < b.N; i++ {
+				kernelSink += f(x, w)
+			}
+		})
+	}
+}
+
+func BenchmarkSum(b *testing.B) {
+	benchmarkKernel(b, func(x, _ []float64) float64 { return sumFloat64(x) })
+}
+
+func BenchmarkSumNaive(b *testing.B) {
+	benchmarkKernel(b, func(x, _ []float64) float64 { return naiveSum(x) })
+}
+
+func BenchmarkDot(b *testing.B) {
+	benchmarkKernel(b, dotFloat64)
+}
+
+func BenchmarkDotNaive(b *testing.B) {
+	benchmarkKernel(b, naiveDot)
+}
+
+func BenchmarkReduce(b *testing.B) {
+	benchmarkKernel(b, func(x, _ []float64) float64 { return reduceFloat64(x).max })
+}
+
+func BenchmarkReduceNaive(b *testing.B) {
+	benchmarkKernel(b, func(x, _ []float64) float64 { return naiveReduce(x).max })
+}
@@ -0,0 +1,144 @@
+package main
+
+import (
+	"fmt"
+	"strings"
+	"sync"
+	"time"
+)
+
+// maxLaps bounds the table; the oldest laps are dropped beyond it.
+const maxLaps = 50
+
+// lap is one interactively timed segment. While it runs its statistics are
+// kept in an accumulator, so observing a sample is O(1) in the length of
+// the lap; once stopped only the table row is kept.
+type lap struct {
+	Label      string
+	Start, End time.Time // End is zero while the lap is running
+	*accumulator
+	row lapRow
+}
+
+// lapRow holds the figures the lap table shows.
+type lapRow struct {
+	energyJ            [4]float64 // package, CPU, GPU, ANE
+	meanW, p95W        float64
+	eMHz, pMHz, gpuMHz float64
+	top                []string
+}
+
+func (l *lap) duration() time.Duration {
+	if l.End.IsZero() {
+		return sessionClock.Now().Sub(l.Start)
+	}
+	return l.End.Sub(l.Start)
+}
+
+// summary returns the lap's table row, from the accumulator while the lap
+// is running.
+func (l *lap) summary() lapRow {
+	if l.accumulator == nil {
+		return l.row
+	}
+	r := lapRow{
+		energyJ: [4]float64{l.EnergyJ[metricPackageW], l.EnergyJ[metricCPUW], l.EnergyJ[metricGPUW], l.EnergyJ[metricANEW]},
+		meanW:   l.Stats[metricPackageW].mean(),
+		p95W:    l.Stats[metricPackageW].quantile(95),
+		eMHz:    l.Stats[metricEClusterFreqMHz].Max,
+		pMHz:    l.Stats[metricPClusterFreqMHz].Max,
+		gpuMHz:  l.Stats[metricGPUFreqMHz].Max,
+	}
+	for _, p := range l.topProcesses(3, procCPUMs) {
+		r.top = append(r.top, p.Name)
+	}
+	return r
+}
+
+type lapTracker struct {
+	mu         sync.Mutex
+	laps       []*lap
+	running    *lap
+	count      int       // laps started, for default labels
+	lastToggle time.Time // markers since then name the next lap
+}
+
+// toggle starts a new lap, or stops the running one. A new lap is named
+// after the latest marker set since the last toggle, if any.
+func (t *lapTracker) toggle() {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	now := sessionClock.Now()
+	from := t.lastToggle
+	t.lastToggle = now
+	if t.running != nil {
+		t.running.End = now
+		t.running.row = t.running.summary()
+		t.running.accumulator = nil
+		t.running = nil
+		return
+	}
+	t.count++
+	label, ok := sessionMarkers.labelBetween(from, now)
+	if !ok {
+		label = fmt.Sprintf("Lap %d", t.count)
+	}
+	t.running = &lap{Label: label, Start: now, accumulator: newAccumulator()}
+	if len(t.laps) >= maxLaps {
+		t.laps = append(t.laps[:0], t.laps[1:]...)
+	}
+	t.laps = append(t.laps, t.running)
+}
+
+func (t *lapTracker) observe(s *sample) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if t.running != nil {
+		t.running.observe(s)
+	}
+}
+
+// status is a one-line summary of the running lap for the power panel.
+func (t *lapTracker) status() string {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if t.running == nil {
+		return ""
+	}
+	l := t.running
+	return fmt.Sprintf("%s: %s, %.1f J", l.Label, l.duration().Round(time.Second), l.EnergyJ[metricPackageW])
+}
+
+// table renders the lap comparison table.
+func (t *lapTracker) table() string {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if len(t.laps) == 0 {
+		return "No laps yet. Press 'b' to start and stop a lap, 't' to return."
+	}
+	var sb strings.Builder
+	fmt.Fprintf(&sb, "%-16s %9s %8s %8s %8s %8s %7s %7s %7s %7s %7s  %s\n",
+		"lap", "duration", "pkg J", "cpu J", "gpu J", "ane J", "mean W", "p95 W", "E MHz", "P MHz", "GPU MHz", "top processes (CPU)")
+	for _, l := range t.laps {
+		label := l.Label
+		if r := []rune(label); len(r) > 15 {
+			label = string(r[:15])
+		}
+		if l.End.IsZero() {
+			label += "*"
+		}
+		r := l.summary()
+		fmt.Fprintf(&sb, "%-16s %9s %8.1f %8.1f %8.1f %8.1f %7.2f %7.2f %7.0f %7.0f %7.0f  %s\n",
+			label,
+			l.duration().Round(100*time.Millisecond),
+			r.energyJ[0], r.energyJ[1], r.energyJ[2], r.energyJ[3],
+			r.meanW, r.p95W,
+			r.eMHz, r.pMHz, r.gpuMHz,
+			strings.Join(r.top, ", "),
+		)
+	}
+	sb.WriteString("\n* running. Press 'b' to start/stop a lap, 't' to return.")
+	return sb.String()
+}
+
+var sessionLaps lapTracker
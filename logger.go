@@ -0,0 +1,242 @@
+package main
+
+import (
+	"fmt"
+	"os"
+	"strings"
+	"sync"
+	"time"
+)
+
+const (
+	logRingSize    = 1000
+	logMaxSize     = 4 << 20 // rotate /var/log/mactop.log past 4 MiB
+	logBurst       = 5       // identical messages allowed per logRateWindow
+	logRateWindow  = 10 * time.Second
+	logPath        = "/var/log/mactop.log"
+	logRotatedPath = logPath + ".1"
+)
+
+type logEntry struct {
+	Time  time.Time
+	Level string
+	Msg   string
+}
+
+func (e logEntry) String() string {
+	return fmt.Sprintf("%s %-5s %s", e.Time.Format("15:04:05.000"), e.Level, e.Msg)
+}
+
+type logRate struct {
+	windowStart time.Time
+	count       int
+	suppressed  int
+}
+
+// ringLogger appends entries to an in-memory ring and leaves writing them
+// out to a background goroutine, so callers on the collection path never
+// wait on disk. Repeats of the same format string beyond logBurst per
+// logRateWindow are counted instead of logged, and the count is reported
+// once the window has passed.
+type ringLogger struct {
+	mu      sync.Mutex
+	writeMu sync.Mutex // serializes flushes, so batches are written in order
+	entries [logRingSize]logEntry
+	seq     uint64 // entries ever appended
+	flushed uint64 // entries written to out
+	rates   map[string]*logRate
+	out     *os.File
+	size    int64 // bytes in out, for rotation
+	wake    chan struct{}
+}
+
+func newRingLogger(out *os.File) *ringLogger {
+	l := &ringLogger{
+		rates: make(map[string]*logRate),
+		out:   out,
+		wake:  make(chan struct{}, 1),
+	}
+	go l.flushLoop()
+	return l
+}
+
+func (l *ringLogger) Printf(format string, args ...interface{}) {
+	l.log("INFO", format, args...)
+}
+
+func (l *ringLogger) Errorf(format string, args ...interface{}) {
+	l.log("ERROR", format, args...)
+}
+
+// Fatalf logs, flushes synchronously and exits, like log.Fatalf.
+func (l *ringLogger) Fatalf(format string, args ...interface{}) {
+	l.log("FATAL", format, args...)
+	l.close()
+	os.Exit(1)
+}
+
+// Write lets the standard library logger share the ring. Panics and runtime
+// errors bypass it and go to fd 2 directly.
+func (l *ringLogger) Write(p []byte) (int, error) {
+	l.append(logEntry{Time: sessionClock.Now(), Level: "INFO", Msg: strings.TrimRight(string(p), "\n")})
+	return len(p), nil
+}
+
+func (l *ringLogger) log(level, format string, args ...interface{}) {
+	now := sessionClock.Now()
+	l.mu.Lock()
+	r := l.rates[format]
+	if r == nil {
+		r = &logRate{windowStart: now}
+		l.rates[format] = r
+	}
+	if now.Sub(r.windowStart) >= logRateWindow {
+		l.reportSuppressedLocked(format, r, now)
+		*r = logRate{windowStart: now}
+	}
+	r.count++
+	if r.count > logBurst {
+		r.suppressed++
+		l.mu.Unlock()
+		return
+	}
+	l.mu.Unlock()
+	l.append(logEntry{Time: now, Level: level, Msg: strings.TrimRight(fmt.Sprintf(format, args...), "\n")})
+}
+
+func (l *ringLogger) reportSuppressedLocked(format string, r *logRate, now time.Time) {
+	if r.suppressed > 0 {
+		l.appendLocked(logEntry{Time: now, Level: "WARN", Msg: fmt.Sprintf("suppressed %d repeats of %q", r.suppressed, format)})
+		r.suppressed = 0
+	}
+}
+
+// reportSuppressed logs the repeats counted in windows that have ended, or
+// in every window when all is set, so a burst that stops is still reported.
+func (l *ringLogger) reportSuppressed(all bool) {
+	now := sessionClock.Now()
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	for format, r := range l.rates {
+		if all || now.Sub(r.windowStart) >= logRateWindow {
+			l.reportSuppressedLocked(format, r, now)
+		}
+	}
+}
+
+func (l *ringLogger) append(e logEntry) {
+	l.mu.Lock()
+	l.appendLocked(e)
+	l.mu.Unlock()
+	select {
+	case l.wake <- struct{}{}:
+	default:
+	}
+}
+
+func (l *ringLogger) appendLocked(e logEntry) {
+	l.entries[l.seq%logRingSize] = e
+	l.seq++
+}
+
+// count is the number of entries ever logged.
+func (l *ringLogger) count() uint64 {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	return l.seq
+}
+
+// recent returns up to n of the newest entries, oldest first.
+func (l *ringLogger) recent(n int) []logEntry {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	if uint64(n) > l.seq {
+		n = int(l.seq)
+	}
+	if n > logRingSize {
+		n = logRingSize
+	}
+	out := make([]logEntry, 0, n)
+	for s := l.seq - uint64(n); s < l.seq; s++ {
+		out = append(out, l.entries[s%logRingSize])
+	}
+	return out
+}
+
+// setOutput switches the flush target, e.g. from stderr to the log file.
+func (l *ringLogger) setOutput(out *os.File) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	l.out = out
+	l.size = 0
+	if st, err := out.Stat(); err == nil {
+		l.size = st.Size()
+	}
+}
+
+func (l *ringLogger) flushLoop() {
+	tick := time.NewTicker(logRateWindow / 2)
+	defer tick.Stop()
+	for {
+		select {
+		case <-l.wake:
+		case <-tick.C:
+			l.reportSuppressed(false)
+		}
+		l.flush()
+	}
+}
+
+// close reports any pending suppressed repeats and writes out everything
+// logged so far. Running sessions call it before they exit.
+func (l *ringLogger) close() {
+	l.reportSuppressed(true)
+	l.flush()
+}
+
+func (l *ringLogger) flush() {
+	l.writeMu.Lock()
+	defer l.writeMu.Unlock()
+	l.mu.Lock()
+	var sb strings.Builder
+	if l.seq-l.flushed > logRingSize {
+		fmt.Fprintf(&sb, "%s WARN  log ring overrun, %d entries lost\n", sessionClock.Now().Format("15:04:05.000"), l.seq-l.flushed-logRingSize)
+		l.flushed = l.seq - logRingSize
+	}
+	for ; l.flushed < l.seq; l.flushed++ {
+		sb.WriteString(l.entries[l.flushed%logRingSize].String())
+		sb.WriteByte('\n')
+	}
+	if sb.Len() == 0 {
+		l.mu.Unlock()
+		return
+	}
+	out := l.out
+	l.size += int64(sb.Len())
+	rotate := out != os.Stderr && l.size > logMaxSize
+	l.mu.Unlock()
+
+	out.WriteString(sb.String())
+	if rotate {
+		l.rotate()
+	}
+}
+
+// rotate moves the current log aside and points the logger and stderr at a
+// fresh file.
+func (l *ringLogger) rotate() {
+	if err := os.Rename(logPath, logRotatedPath); err != nil {
+		return
+	}
+	logfile, err := os.OpenFile(logPath, os.O_CREATE|os.O_WRONLY|os.O_APPEND, 0660)
+	if err != nil {
+		return
+	}
+	StderrToLogfile(logfile)
+	l.mu.Lock()
+	old := l.out
+	l.out = logfile
+	l.size = 0
+	l.mu.Unlock()
+	old.Close()
+}
@@ -11,12 +11,13 @@ import (
 	"os"
 	"os/exec"
 	"os/signal"
-	"regexp"
 	"sort"
 	"strconv"
 	"strings"
+	"sync"
 	"syscall"
 	"time"
+	"unsafe"
 
 	ui "github.com/gizak/termui/v3"
 	w "github.com/gizak/termui/v3/widgets"
@@ -39,67 +40,42 @@ type GPUMetrics struct {
 }
 
 type ProcessMetrics struct {
-	ID       int
-	Name     string
-	CPUUsage float64
+	ID           int
+	Name         string
+	CPUUsage     float64
+	GPUUsage     float64 // ms/s, when powermetrics reports it
+	EnergyImpact float64
 }
 
 type MemoryMetrics struct {
 	Total, Used, Available, SwapTotal, SwapUsed uint64
 }
 
-type EventThrottler struct {
-	timer       *time.Timer
-	gracePeriod time.Duration
-
-	C chan struct{}
-}
-
-func NewEventThrottler(gracePeriod time.Duration) *EventThrottler {
-	return &EventThrottler{
-		timer:       nil,
-		gracePeriod: gracePeriod,
-		C:           make(chan struct{}, 1),
-	}
-}
-
-func (e *EventThrottler) Notify() {
-	if e.timer != nil {
-		return
-	}
-
-	e.timer = time.AfterFunc(e.gracePeriod, func() {
-		e.timer = nil
-		select {
-		case e.C <- struct{}{}:
-		default:
-		}
-	})
-}
-
 var (
 	cpu1Gauge, cpu2Gauge, gpuGauge, aneGauge        *w.Gauge
 	TotalPowerChart                                 *w.BarChart
 	memoryGauge                                     *w.Gauge
 	modelText, PowerChart, NetworkInfo, ProcessInfo *w.Paragraph
+	modelInfo                                       string // modelText without baseline drift
 	grid                                            *ui.Grid
 	powerValues                                     []float64
 	lastUpdateTime                                  time.Time
-	stderrLogger                                    = log.New(os.Stderr, "", 0)
+	stderrLogger                                    = newRingLogger(os.Stderr)
 	currentGridLayout                               = "default"
 	updateInterval                                  = 1000
-)
-
-var (
-	dataRegex   = regexp.MustCompile(`(?m)^\s*(\S.*?)\s+(\d+)\s+(\d+\.\d+)\s+\d+\.\d+\s+`)
-	outRegex    = regexp.MustCompile(`out:\s*([\d.]+)\s*packets/s,\s*([\d.]+)\s*bytes/s`)
-	inRegex     = regexp.MustCompile(`in:\s*([\d.]+)\s*packets/s,\s*([\d.]+)\s*bytes/s`)
-	readRegex   = regexp.MustCompile(`read:\s*([\d.]+)\s*ops/s\s*([\d.]+)\s*KBytes/s`)
-	writeRegex  = regexp.MustCompile(`write:\s*([\d.]+)\s*ops/s\s*([\d.]+)\s*KBytes/s`)
-	residencyRe = regexp.MustCompile(`(\w+-Cluster)\s+HW active residency:\s+(\d+\.\d+)%`)
-	frequencyRe = regexp.MustCompile(`(\w+-Cluster)\s+HW active frequency:\s+(\d+)\s+MHz`)
-	re          = regexp.MustCompile(`GPU\s*(HW)?\s*active\s*(residency|frequency):\s+(\d+\.\d+)%?`)
-	freqRe      = regexp.MustCompile(`(\d+)\s*MHz:\s*(\d+)%`)
+	renderInterval                                  = 0 // ms, defaults to half the update interval
+	memoryInterval                                  = 1000
+	sessionHistory                                  = newHistory(86400) // 24h at the default interval
+	lapTable, logView                               *w.Paragraph
+	powerPixelChart                                 *pixelChart // nil unless the terminal draws bitmaps
+	lastPixelSample                                 time.Time
+	printSummary                                    bool
+	summaryJSONPath                                 string
+	recordDir                                       string
+	statsdTarget, influxTarget                      string
+	exitOnce                                        sync.Once
+	activeView                                      = "grid"
+	logShown                                        uint64 // log entries when the log view was drawn
 )
 
 func setupUI() {
@@ -122,13 +98,14 @@ func setupUI() {
 	if !ok {
 		gpuCoreCount = "?"
 	}
-	modelText.Text = fmt.Sprintf("%s\nTotal Cores: %d\nE-Cores: %d\nP-Cores: %d\nGPU Cores: %s",
+	modelInfo = fmt.Sprintf("%s\nTotal Cores: %d\nE-Cores: %d\nP-Cores: %d\nGPU Cores: %s",
 		modelName,
 		eCoreCount+pCoreCount,
 		eCoreCount,
 		pCoreCount,
 		gpuCoreCount,
 	)
+	modelText.Text = modelInfo
 	stderrLogger.Printf("Model: %s\nE-Core Count: %d\nP-Core Count: %d\nGPU Core Count: %s",
 		modelName,
 		eCoreCount,
@@ -179,14 +156,31 @@ func setupUI() {
 	memoryGauge.Title = "Memory Usage"
 	memoryGauge.Percent = 0
 	memoryGauge.BarColor = ui.ColorCyan
+
+	lapTable = w.NewParagraph()
+	lapTable.Title = "Laps"
+
+	logView = w.NewParagraph()
+	logView.Title = "Recent Log ('g' to return)"
 }
 
 func setupGrid() {
-	grid = ui.NewGrid()
-	grid.Set(
-		ui.NewRow(1.0/2, // This row now takes half the height of the grid
-			ui.NewCol(1.0/2, ui.NewRow(1.0/2, cpu1Gauge), ui.NewCol(1.0, ui.NewRow(1.0, cpu2Gauge))),
-			ui.NewCol(1.0/2, ui.NewRow(1.0/2, gpuGauge), ui.NewCol(1.0, ui.NewRow(1.0, aneGauge))), // ui.NewCol(1.0/2, ui.NewRow(1.0, ProcessInfo)), // ProcessInfo spans this entire column
+	grid = defaultGrid()
+}
+
+// defaultGrid lays out the gauges beside the process table, with the model,
+// network and power panels and memory below.
+func defaultGrid() *ui.Grid {
+	g := ui.NewGrid()
+	g.Set(
+		ui.NewRow(1.0/2, // This row takes half the height of the grid
+			ui.NewCol(1.0/2,
+				ui.NewRow(1.0/4, cpu1Gauge),
+				ui.NewRow(1.0/4, cpu2Gauge),
+				ui.NewRow(1.0/4, gpuGauge),
+				ui.NewRow(1.0/4, aneGauge),
+			),
+			ui.NewCol(1.0/2, ProcessInfo), // ProcessInfo spans this entire column
 		),
 		ui.NewRow(1.0/4,
 			ui.NewCol(1.0/6, modelText),
@@ -198,15 +192,20 @@ func setupGrid() {
 			ui.NewCol(1.0, memoryGauge),
 		),
 	)
+	return g
 }
 
 func switchGridLayout() {
+	var newGrid *ui.Grid
 	if currentGridLayout == "default" {
-		newGrid := ui.NewGrid()
+		newGrid = ui.NewGrid()
 		newGrid.Set(
-			ui.NewRow(1.0/2, // This row now takes half the height of the grid
-				ui.NewCol(1.0/2, ui.NewRow(1.0, cpu1Gauge)), // ui.NewCol(1.0, ui.NewRow(1.0, cpu2Gauge))),
-				ui.NewCol(1.0/2, ui.NewRow(1.0, cpu2Gauge)), // ProcessInfo spans this entire column
+			ui.NewRow(1.0/2,
+				ui.NewCol(1.0/2,
+					ui.NewRow(1.0/2, cpu1Gauge),
+					ui.NewRow(1.0/2, cpu2Gauge),
+				),
+				ui.NewCol(1.0/2, ProcessInfo),
 			),
 			ui.NewRow(1.0/4,
 				ui.NewCol(1.0/4, gpuGauge),
@@ -220,32 +219,112 @@ func switchGridLayout() {
 				ui.NewCol(2.0/6, NetworkInfo),
 			),
 		)
-		termWidth, termHeight := ui.TerminalDimensions()
-		newGrid.SetRect(0, 0, termWidth, termHeight)
-		grid = newGrid
 		currentGridLayout = "alternative"
 	} else {
-		newGrid := ui.NewGrid()
-		newGrid.Set(
-			ui.NewRow(1.0/2,
-				ui.NewCol(1.0/2, ui.NewRow(1.0/2, cpu1Gauge), ui.NewCol(1.0, ui.NewRow(1.0, cpu2Gauge))),
-				ui.NewCol(1.0/2, ui.NewRow(1.0/2, gpuGauge), ui.NewCol(1.0, ui.NewRow(1.0, aneGauge))),
-			),
-			ui.NewRow(1.0/4,
-				ui.NewCol(1.0/4, modelText),
-				ui.NewCol(1.0/4, NetworkInfo),
-				ui.NewCol(1.0/4, PowerChart),
-				ui.NewCol(1.0/4, TotalPowerChart),
-			),
-			ui.NewRow(1.0/4,
-				ui.NewCol(1.0, memoryGauge),
-			),
-		)
-		termWidth, termHeight := ui.TerminalDimensions()
-		newGrid.SetRect(0, 0, termWidth, termHeight)
-		grid = newGrid
+		newGrid = defaultGrid()
 		currentGridLayout = "default"
 	}
+	termWidth, termHeight := ui.TerminalDimensions()
+	newGrid.SetRect(0, 0, termWidth, termHeight)
+	grid = newGrid
+}
+
+// renderUI draws the active view: the metrics grid or a full-screen panel.
+func renderUI() {
+	switch activeView {
+	case "laps":
+		lapTable.Text = sessionLaps.table()
+		ui.Render(lapTable)
+	case "log":
+		logShown = stderrLogger.count()
+		var sb strings.Builder
+		for _, e := range stderrLogger.recent(logView.Inner.Dy()) {
+			sb.WriteString(e.String())
+			sb.WriteByte('\n')
+		}
+		logView.Text = sb.String()
+		ui.Render(logView)
+	default:
+		ui.Render(grid)
+		if powerPixelChart != nil {
+			powerPixelChart.draw(os.Stdout, TotalPowerChart.Inner)
+		}
+		return
+	}
+	if powerPixelChart != nil {
+		powerPixelChart.hide(os.Stdout)
+	}
+}
+
+// shutdown stops collection, restores the terminal, emits the optional
+// session summary and exits. Only the first caller gets through.
+func shutdown(done chan struct{}) {
+	exitOnce.Do(func() {
+		close(done)
+		closeUI()
+		if sessionRecorder != nil {
+			sessionRecorder.close()
+		}
+		for _, e := range emitters {
+			e.close()
+		}
+		if traceOutPath != "" {
+			finishTraceFile(traceOutPath)
+		}
+		if sessionCheckpoint != nil {
+			if err := sessionCheckpoint.close(); err != nil {
+				fmt.Println("Error: failed to write the checkpoint:", err)
+			}
+		}
+		if sessionProfile != nil {
+			if tree, err := readProcessTree(); err == nil {
+				sessionProfile.resolve(tree)
+			}
+			if err := sessionProfile.write(pprofPath, sessionClock.Now()); err != nil {
+				fmt.Println("Error: failed to write the energy profile:", err)
+			}
+		}
+		if sessionBaseline != nil {
+			if err := sessionBaseline.save(); err != nil {
+				fmt.Println("Error: failed to update the baseline:", err)
+			}
+		}
+		if printSummary || summaryJSONPath != "" {
+			summary := currentSessionSummary()
+			if printSummary {
+				summary.writeText(os.Stdout)
+			}
+			if summaryJSONPath != "" {
+				if err := writeSummaryJSON(summaryJSONPath, summary); err != nil {
+					fmt.Println("Error: failed to write session summary:", err)
+				}
+			}
+		}
+		if startupReport {
+			startupTrace.write(os.Stdout)
+		}
+		stderrLogger.close()
+		os.Exit(0)
+	})
+}
+
+// closeUI restores the terminal, removing any bitmaps we placed on it.
+func closeUI() {
+	if powerPixelChart != nil {
+		powerPixelChart.hide(os.Stdout)
+	}
+	ui.Close()
+}
+
+// toggleView switches between the grid and a full-screen panel.
+func toggleView(view string) {
+	if activeView == view {
+		activeView = "grid"
+	} else {
+		activeView = view
+	}
+	ui.Clear()
+	renderUI()
 }
 
 func StderrToLogfile(logfile *os.File) {
@@ -255,19 +334,69 @@ func StderrToLogfile(logfile *os.File) {
 func main() {
 	var (
 		colorName             string
+		graphicsMode          = "auto"
 		interval              int
 		err                   error
 		setColor, setInterval bool
 	)
 	version := "v0.1.8"
+	if len(os.Args) > 1 {
+		var run func([]string) int
+		switch os.Args[1] {
+		case "mark", "marks":
+			run = func(args []string) int { return runMarkerClient(os.Args[1], args) }
+		case "query":
+			run = runQuery
+		case "soak":
+			run = runSoak
+		case "snapshot":
+			run = runSnapshot
+		case "bench-startup":
+			run = runBenchStartup
+		case "export":
+			run = runExport
+		}
+		if run != nil {
+			code := run(os.Args[2:])
+			stderrLogger.close()
+			os.Exit(code)
+		}
+	}
 	for i := 1; i < len(os.Args); i++ {
 		switch os.Args[i] {
 		case "--help", "-h":
 			fmt.Println("Usage: mactop [--help] [--version] [--interval] [--color]")
+			fmt.Println("       mactop mark <label> | mactop marks [<from-label> <to-label>]")
+			fmt.Println("       mactop query <recording> --metric <names> [--from T] [--to T] [--step D] [--agg A] [--format csv|json]")
+			fmt.Println("       mactop snapshot [--json] [--interval 200] [--processes 10]")
+			fmt.Println("       mactop export --trace <recording> <out.json> [--from T] [--to T]")
+			fmt.Println("       mactop bench-startup [--runs 10] [-- mactop flags]")
 			fmt.Println("--help: Show this help message")
 			fmt.Println("--version: Show the version of mactop")
 			fmt.Println("--interval: Set the powermetrics update interval in milliseconds. Default is 1000.")
+			fmt.Println("--render-interval: Set how often the UI is redrawn in milliseconds. Default is half the update interval.")
+			fmt.Println("--memory-interval: Set how often memory usage is sampled in milliseconds. Default is 1000.")
+			fmt.Println("--baseline: Keep this machine's idle power, idle residency and hourly frequency profile in the given file and flag drift from it. 'off' disables it. Default is /var/db/mactop/baseline.json.")
+			fmt.Println("--battery-policy: On battery, sample half as often without per-process data and redraw half as often. Options are 'auto' and 'off'. Default is auto.")
+			fmt.Println("--graphics: Draw the power chart as a bitmap. Options are 'auto', 'kitty', 'sixel' and 'off'. Default is auto.")
+			fmt.Println("--statsd: Push every sample as StatsD gauges to host:port (UDP), a udp:// or unixgram:// address, or a file.")
+			fmt.Println("--influx: Push every sample in Influx line protocol to a udp:// or unixgram:// address, or append it to a file.")
+			fmt.Println("--summary: Print a session summary (energy, mean/p95/max per metric, top processes) on exit.")
+			fmt.Println("--summary-json: Also write the session summary as JSON to the given file on exit.")
+			fmt.Println("--record: Record every sample, with minute and hour rollups and markers, to the given directory.")
+			fmt.Println("--checkpoint: Keep the session totals in the given file and resume them after a restart on the same host and boot.")
+			fmt.Println("--pprof: On exit, write CPU time, GPU time and estimated energy per process, stacked by process tree, as a pprof profile.")
+			fmt.Println("--trace: Stream every sample, the top processes and markers to the given file as a Chrome/Perfetto trace.")
+			fmt.Println("--record-max-size: Cap the recording at this many megabytes, deleting the oldest segments. Default is 1024.")
+			fmt.Println("--startup-report: Exit after the first frame with data and print how long each startup phase took.")
 			fmt.Println("--color: Set the UI color. Default is white. Options are 'green', 'red', 'blue', 'cyan', 'magenta', 'yellow', and 'white'. (-c green)")
+			fmt.Println("mark: Add a named marker to the running mactop session (no sudo needed).")
+			fmt.Println("marks: Print energy and power percentiles per marker phase, or between two markers.")
+			fmt.Println("soak: Replay a long simulated session through the pipeline at high speed and check memory, goroutine, fd and table bounds.")
+			fmt.Println("snapshot: Take one short powermetrics sample and print it, as text or JSON, without the UI.")
+			fmt.Println("query: Aggregate metrics from a recording over a time range, per step, as CSV or JSON.")
+			fmt.Println("export: Write a recording as a Chrome/Perfetto trace, with markers as instant events.")
+			fmt.Println("bench-startup: Run mactop --startup-report repeatedly and print min/median/max per startup phase.")
 			fmt.Println("You must use sudo to run mactop, as powermetrics requires root privileges.")
 			fmt.Println("For more information, see https://github.com/context-labs/mactop")
 			os.Exit(0)
@@ -302,23 +431,177 @@ func main() {
 				fmt.Println("Error: --interval flag requires an interval value")
 				os.Exit(1)
 			}
+		case "--graphics":
+			if i+1 < len(os.Args) {
+				graphicsMode = strings.ToLower(os.Args[i+1])
+				i++
+			} else {
+				fmt.Println("Error: --graphics flag requires a mode")
+				os.Exit(1)
+			}
+		case "--summary":
+			printSummary = true
+		case "--startup-report":
+			startupReport = true
+		case "--baseline":
+			if i+1 < len(os.Args) {
+				baselinePath = os.Args[i+1]
+				if baselinePath == "off" {
+					baselinePath = ""
+				}
+				i++
+			} else {
+				fmt.Println("Error: --baseline flag requires a file path or 'off'")
+				os.Exit(1)
+			}
+		case "--battery-policy":
+			if i+1 < len(os.Args) && (os.Args[i+1] == "auto" || os.Args[i+1] == "off") {
+				batteryPolicy = os.Args[i+1]
+				i++
+			} else {
+				fmt.Println("Error: --battery-policy flag requires 'auto' or 'off'")
+				os.Exit(1)
+			}
+		case "--record":
+			if i+1 < len(os.Args) {
+				recordDir = os.Args[i+1]
+				i++
+			} else {
+				fmt.Println("Error: --record flag requires a directory")
+				os.Exit(1)
+			}
+		case "--checkpoint":
+			if i+1 < len(os.Args) {
+				checkpointPath = os.Args[i+1]
+				i++
+			} else {
+				fmt.Println("Error: --checkpoint flag requires a file path")
+				os.Exit(1)
+			}
+		case "--pprof":
+			if i+1 < len(os.Args) {
+				pprofPath = os.Args[i+1]
+				i++
+			} else {
+				fmt.Println("Error: --pprof flag requires a file path")
+				os.Exit(1)
+			}
+		case "--trace":
+			if i+1 < len(os.Args) {
+				traceOutPath = os.Args[i+1]
+				i++
+			} else {
+				fmt.Println("Error: --trace flag requires a file path")
+				os.Exit(1)
+			}
+		case "--statsd", "--influx":
+			if i+1 < len(os.Args) {
+				if os.Args[i] == "--statsd" {
+					statsdTarget = os.Args[i+1]
+				} else {
+					influxTarget = os.Args[i+1]
+				}
+				i++
+			} else {
+				fmt.Printf("Error: %s flag requires a target address\n", os.Args[i])
+				os.Exit(1)
+			}
+		case "--record-max-size":
+			if i+1 < len(os.Args) {
+				mb, err := strconv.Atoi(os.Args[i+1])
+				if err != nil || mb <= 0 {
+					fmt.Println("Invalid --record-max-size:", os.Args[i+1])
+					os.Exit(1)
+				}
+				recordMaxSizeMB = mb
+				i++
+			} else {
+				fmt.Println("Error: --record-max-size flag requires a size in megabytes")
+				os.Exit(1)
+			}
+		case "--summary-json":
+			if i+1 < len(os.Args) {
+				summaryJSONPath = os.Args[i+1]
+				i++
+			} else {
+				fmt.Println("Error: --summary-json flag requires a file path")
+				os.Exit(1)
+			}
+		case "--render-interval", "--memory-interval":
+			if i+1 < len(os.Args) {
+				ms, err := strconv.Atoi(os.Args[i+1])
+				if err != nil || ms <= 0 {
+					fmt.Printf("Invalid %s: %s\n", os.Args[i], os.Args[i+1])
+					os.Exit(1)
+				}
+				if os.Args[i] == "--render-interval" {
+					renderInterval = ms
+				} else {
+					memoryInterval = ms
+				}
+				i++
+			} else {
+				fmt.Printf("Error: %s flag requires an interval value\n", os.Args[i])
+				os.Exit(1)
+			}
 		}
 	}
+	startupTrace.phase("parse arguments", startupBegin)
 	if os.Geteuid() != 0 {
 		fmt.Println("Welcome to mactop! Please try again and run mactop with sudo privileges!")
 		fmt.Println("Usage: sudo mactop")
 		os.Exit(1)
 	}
+	start := time.Now()
 	logfile, err := setupLogfile()
 	if err != nil {
 		stderrLogger.Fatalf("failed to setup log file: %v", err)
 	}
 	defer logfile.Close()
+	startupTrace.phase("setupLogfile", start)
+
+	start = time.Now()
+	if ln, err := serveMarkers(markerSocketPath); err != nil {
+		stderrLogger.Printf("markers disabled: %v", err)
+	} else {
+		defer ln.Close()
+	}
+	startupTrace.phase("marker socket", start)
+	for _, target := range []struct {
+		name, addr string
+		format     func([]byte, *sample) []byte
+	}{
+		{"statsd", statsdTarget, appendStatsD},
+		{"influx", influxTarget, appendInflux},
+	} {
+		if target.addr == "" {
+			continue
+		}
+		e, err := newEmitter(target.name, target.addr, target.format)
+		if err != nil {
+			stderrLogger.Fatalf("failed to start push emitter: %v", err)
+		}
+		emitters = append(emitters, e)
+	}
+	if traceOutPath != "" {
+		e, err := startTraceFile(traceOutPath)
+		if err != nil {
+			stderrLogger.Fatalf("failed to start trace: %v", err)
+		}
+		emitters = append(emitters, e)
+	}
+	if recordDir != "" {
+		if sessionRecorder, err = startRecorder(recordDir, int64(recordMaxSizeMB)<<20); err != nil {
+			stderrLogger.Fatalf("failed to start recording: %v", err)
+		}
+	}
 
+	start = time.Now()
 	if err := ui.Init(); err != nil {
 		stderrLogger.Fatalf("failed to initialize termui: %v", err)
 	}
 	defer ui.Close()
+	startupTrace.phase("ui.Init", start)
 	StderrToLogfile(logfile)
 	if setColor {
 		var color ui.Color
@@ -359,137 +642,265 @@ func main() {
 	if setInterval {
 		updateInterval = interval
 	}
+	if renderInterval == 0 {
+		renderInterval = updateInterval / 2
+	}
+	start = time.Now()
 	setupGrid()
+	startupTrace.phase("setupGrid", start)
+	chartColor := ui.ColorGreen
+	if len(ui.Theme.BarChart.Bars) > 0 {
+		chartColor = ui.Theme.BarChart.Bars[0]
+	}
+	powerPixelChart = newPixelChart(detectGraphics(graphicsMode), chartColor)
 
 	termWidth, termHeight := ui.TerminalDimensions()
 	grid.SetRect(0, 0, termWidth, termHeight)
-	ui.Render(grid)
+	lapTable.SetRect(0, 0, termWidth, termHeight)
+	logView.SetRect(0, 0, termWidth, termHeight)
+	renderUI()
+	startupTrace.milestone("first frame")
 
-	cpuMetricsChan := make(chan CPUMetrics)
-	gpuMetricsChan := make(chan GPUMetrics)
-	netdiskMetricsChan := make(chan NetDiskMetrics)
-	processMetricsChan := make(chan []ProcessMetrics)
+	samples := make(chan *sample)
 
 	done := make(chan struct{})
 	quit := make(chan os.Signal, 1)
 	signal.Notify(quit, os.Interrupt, syscall.SIGTERM)
 
 	appleSiliconModel := getSOCInfo()
-	go collectMetrics(done, cpuMetricsChan, gpuMetricsChan, netdiskMetricsChan, processMetricsChan, appleSiliconModel["name"].(string))
-	lastUpdateTime = time.Now()
-	needRender := NewEventThrottler(time.Duration(updateInterval/2) * time.Millisecond)
-	go func() {
-		for {
-			select {
-			case cpuMetrics := <-cpuMetricsChan:
-				updateCPUUI(cpuMetrics)
-				updateTotalPowerChart(cpuMetrics.PackageW)
-				needRender.Notify()
-			case gpuMetrics := <-gpuMetricsChan:
-				updateGPUUI(gpuMetrics)
-				needRender.Notify()
-			case netdiskMetrics := <-netdiskMetricsChan:
-				updateNetDiskUI(netdiskMetrics)
-				needRender.Notify()
-			case processMetrics := <-processMetricsChan:
-				updateProcessUI(processMetrics)
-				needRender.Notify()
-			case <-needRender.C:
-				ui.Render(grid)
-			case <-quit:
-				close(done)
-				ui.Close()
-				os.Exit(0)
-				return
+	cores := appleSiliconModel["e_core_count"].(int) + appleSiliconModel["p_core_count"].(int)
+	pool := newSamplePool(8, cores, 512)
+	if baselinePath != "" {
+		sessionBaseline = loadBaseline(baselinePath, machineKey(appleSiliconModel["name"].(string)))
+	}
+	if pprofPath != "" {
+		sessionProfile = newEnergyProfile()
+	}
+	if checkpointPath != "" {
+		if sessionCheckpoint, err = openCheckpoint(checkpointPath); err != nil {
+			stderrLogger.Fatalf("failed to open checkpoint: %v", err)
+		}
+	}
+	go collectMetrics(done, samples, pool, appleSiliconModel["name"].(string))
+	lastUpdateTime = sessionClock.Now()
+
+	// All periodic UI work runs from the loop below, batched on the
+	// scheduler's ticks; metric updates only mark the screen dirty.
+	sched := newScheduler(sessionClock, 50*time.Millisecond)
+	needRender, firstSample := false, true
+	memoryRequest := make(chan struct{}, 1)
+	go sampleMemoryLoop(done, memoryRequest)
+	sessionMerger.staleAfter[sourceMemory] = 3 * time.Duration(memoryInterval) * time.Millisecond
+	sessionMerger.keepMemory(batteryCollectionPolicy().interval, memoryInterval) // the longest interval we sample at
+	sched.every("memory", time.Duration(memoryInterval)*time.Millisecond, func() {
+		select {
+		case memoryRequest <- struct{}{}:
+		default: // previous read still in flight
+		}
+		memoryMetrics, age, stale := sessionMerger.alignMemory(sessionClock.Now())
+		title, percent := memoryGauge.Title, memoryGauge.Percent
+		updateMemoryUI(memoryMetrics, age, stale)
+		if memoryGauge.Title != title || memoryGauge.Percent != percent {
+			needRender = true
+		}
+	})
+	sched.every("power-rollup", 2*time.Second, func() {
+		if rollupTotalPowerChart() {
+			needRender = true
+		}
+	})
+	batteryRequest := make(chan struct{}, 1)
+	batteryRequest <- struct{}{}
+	go sampleBatteryLoop(done, batteryRequest)
+	sched.every("battery", batteryInterval, func() {
+		if applyBattery(sched) {
+			needRender = true
+		}
+		select {
+		case batteryRequest <- struct{}{}:
+		default:
+		}
+	})
+	if sessionProfile != nil {
+		go sampleProcessTreeLoop(done, sessionProfile.treeRequest)
+		sched.every("process-tree", processTreeInterval, sessionProfile.requestTree)
+	}
+	if sessionCheckpoint != nil {
+		sched.every("checkpoint", checkpointInterval, func() {
+			if err := sessionCheckpoint.save(); err != nil {
+				stderrLogger.Errorf("checkpoint: %v", err)
 			}
+		})
+	}
+	sched.every("baseline", 30*time.Second, func() {
+		if sessionBaseline == nil {
+			return
 		}
-	}()
+		text := modelInfo
+		for _, d := range sessionBaseline.drift() {
+			text += "\n" + d
+		}
+		if text != modelText.Text {
+			modelText.Text = text
+			needRender = true
+		}
+	})
+	// Nothing is drawn while idle: only samples, keys and tasks that changed
+	// what is on screen set needRender.
+	sched.every("render", time.Duration(renderInterval)*time.Millisecond, func() {
+		if activeView == "log" && stderrLogger.count() != logShown {
+			needRender = true
+		}
+		if needRender {
+			renderUI()
+			needRender = false
+		}
+	})
+	// Samples, scheduler ticks and key presses are all handled here, on one
+	// goroutine, so the widgets, the grid and the active view are never
+	// touched concurrently.
 	uiEvents := ui.PollEvents()
 	for {
 		select {
+		case s := <-samples:
+			updateCPUUI(s.CPU)
+			updateTotalPowerChart(s.CPU.PackageW)
+			updateGPUUI(s.GPU)
+			updateNetDiskUI(s.NetDisk)
+			updateProcessUI(s.Processes)
+			s.release()
+			needRender = true
+			if firstSample {
+				// Show the first data right away rather than on the next
+				// render tick.
+				firstSample = false
+				startupTrace.milestone("first sample")
+				renderUI()
+				needRender = false
+				startupTrace.finish()
+				if startupReport {
+					shutdown(done)
+				}
+			}
+		case <-sched.C:
+			sched.fire()
+		case <-quit:
+			shutdown(done)
 		case e := <-uiEvents:
-			switch e.ID {
-			case "q", "<C-c>": // "q" or Ctrl+C to quit
-				close(done)
-				ui.Close()
-				os.Exit(0)
-				return
-			case "<Resize>":
-				payload := e.Payload.(ui.Resize)
-				grid.SetRect(0, 0, payload.Width, payload.Height)
-				ui.Render(grid)
-			case "r":
-				// refresh ui data
-				termWidth, termHeight := ui.TerminalDimensions()
-				grid.SetRect(0, 0, termWidth, termHeight)
-				ui.Clear()
-				ui.Render(grid)
-			case "l":
-				// Set the new grid's dimensions to match the terminal size
-				termWidth, termHeight := ui.TerminalDimensions()
-				grid.SetRect(0, 0, termWidth, termHeight)
-				ui.Clear()
-				switchGridLayout()
-				ui.Render(grid)
-			}
-		case <-done:
-			ui.Close()
-			os.Exit(0)
-			return
+			if handleKey(e, done) {
+				needRender = false
+			}
 		}
 	}
 }
 
+// handleKey acts on one terminal event and reports whether it redrew the
+// screen.
+func handleKey(e ui.Event, done chan struct{}) bool {
+	switch e.ID {
+	case "q", "<C-c>": // "q" or Ctrl+C to quit
+		shutdown(done)
+	case "<Resize>":
+		payload := e.Payload.(ui.Resize)
+		grid.SetRect(0, 0, payload.Width, payload.Height)
+		lapTable.SetRect(0, 0, payload.Width, payload.Height)
+		logView.SetRect(0, 0, payload.Width, payload.Height)
+		renderUI()
+	case "r":
+		// refresh ui data
+		termWidth, termHeight := ui.TerminalDimensions()
+		grid.SetRect(0, 0, termWidth, termHeight)
+		ui.Clear()
+		renderUI()
+	case "l":
+		// Set the new grid's dimensions to match the terminal size
+		termWidth, termHeight := ui.TerminalDimensions()
+		grid.SetRect(0, 0, termWidth, termHeight)
+		ui.Clear()
+		switchGridLayout()
+		renderUI()
+	case "b":
+		sessionLaps.toggle()
+		renderUI()
+	case "t":
+		toggleView("laps")
+	case "g":
+		toggleView("log")
+	default:
+		return false
+	}
+	return true
+}
+
 func setupLogfile() (*os.File, error) {
 	if err := os.MkdirAll("/var/log", 0755); err != nil {
 		return nil, fmt.Errorf("failed to make the log directory: %v", err)
 	}
-	logfile, err := os.OpenFile("/var/log/mactop.log", os.O_CREATE|os.O_WRONLY|os.O_TRUNC, 0660)
+	// Keep history across runs, rotating by size instead of truncating.
+	if st, err := os.Stat(logPath); err == nil && st.Size() > logMaxSize {
+		os.Rename(logPath, logRotatedPath)
+	}
+	logfile, err := os.OpenFile(logPath, os.O_CREATE|os.O_WRONLY|os.O_APPEND, 0660)
 	if err != nil {
 		return nil, fmt.Errorf("failed to open log file: %v", err)
 	}
-	log.SetFlags(log.Ltime | log.Lshortfile)
-	log.SetOutput(logfile)
+	log.SetFlags(log.Lshortfile)
+	log.SetOutput(stderrLogger)
+	stderrLogger.setOutput(logfile)
 	return logfile, nil
 }
 
-func collectMetrics(done chan struct{}, cpumetricsChan chan CPUMetrics, gpumetricsChan chan GPUMetrics, netdiskMetricsChan chan NetDiskMetrics, processMetricsChan chan []ProcessMetrics, modelName string) {
-	var cpuMetrics CPUMetrics
-	var gpuMetrics GPUMetrics
-	var netdiskMetrics NetDiskMetrics
-	var processMetrics []ProcessMetrics
-	cmd := exec.Command("powermetrics", "--samplers", "cpu_power,gpu_power,thermal,network,disk", "--show-process-gpu", "--show-process-energy", "--show-initial-usage", "--show-process-netstats", "-i", strconv.Itoa(updateInterval))
+// collectMetrics runs powermetrics and parses its output into samples until
+// done is closed. A policy sent on collectorPolicy restarts powermetrics
+// with new options.
+func collectMetrics(done chan struct{}, samples chan<- *sample, pool *samplePool, modelName string) {
+	policy := collectionPolicy{interval: updateInterval, perProcess: true, initialUsage: true}
+	for {
+		next, ok := runPowermetrics(done, samples, pool, modelName, policy)
+		if !ok {
+			return
+		}
+		policy = next
+	}
+}
+
+// runPowermetrics runs one powermetrics process. It returns the next policy
+// and true when asked to restart, false once done is closed.
+func runPowermetrics(done chan struct{}, samples chan<- *sample, pool *samplePool, modelName string, policy collectionPolicy) (collectionPolicy, bool) {
+	parser := newSampleParser(pool, modelName, policy.interval)
+	cmd := exec.Command("powermetrics", policy.args()...)
 	stdout, err := cmd.StdoutPipe()
 	if err != nil {
 		stderrLogger.Fatalf("failed to get stdout pipe: %v", err)
 	}
+	start := time.Now()
 	if err := cmd.Start(); err != nil {
 		stderrLogger.Fatalf("failed to start command: %v", err)
 	}
+	startupTrace.phase("powermetrics spawn", start)
 	scanner := bufio.NewScanner(stdout)
+	restart := make(chan collectionPolicy, 1)
 	go func() {
 		for {
 			select {
 			case <-done: // Check if we need to exit
 				cmd.Process.Kill() // Ensure subprocess is terminated
-				os.Exit(0)
+				return
+			case p := <-collectorPolicy:
+				if parser.current != nil {
+					parser.current.release() // never completed
+				}
+				restart <- p
+				cmd.Process.Kill()
 				return
 			default:
 				if scanner.Scan() {
-					line := scanner.Text()
-					cpuMetrics = parseCPUMetrics(line, cpuMetrics, modelName)
-					gpuMetrics = parseGPUMetrics(line, gpuMetrics)
-					netdiskMetrics = parseActivityMetrics(line, netdiskMetrics)
-					processMetrics = parseProcessMetrics(line, processMetrics)
-
-					cpumetricsChan <- cpuMetrics
-					gpumetricsChan <- gpuMetrics
-					netdiskMetricsChan <- netdiskMetrics
-					processMetricsChan <- processMetrics
-
+					if s := parser.line(lineString(scanner.Bytes())); s != nil {
+						publishSample(s, samples)
+					}
 				} else {
 					if err := scanner.Err(); err != nil {
-						stderrLogger.Printf("error during scan: %v", err)
+						stderrLogger.Errorf("error during scan: %v", err)
 					}
 					return // Exit loop if Scan() returns false
 				}
@@ -497,27 +908,190 @@ func collectMetrics(done chan struct{}, cpumetricsChan chan CPUMetrics, gpumetri
 		}
 	}()
 	if err := cmd.Wait(); err != nil {
-		stderrLogger.Fatalf("command failed: %v", err)
+		select {
+		case <-done: // killed on purpose while shutting down
+		case p := <-restart:
+			return p, true
+		default:
+			stderrLogger.Fatalf("command failed: %v", err)
+		}
+	}
+	return policy, false
+}
+
+// lineString views a scanner line as a string without copying it. The result
+// is only valid until the next Scan, so parsers must copy anything they keep.
+func lineString(b []byte) string {
+	if len(b) == 0 {
+		return ""
+	}
+	return unsafe.String(&b[0], len(b))
+}
+
+// sampleParser assembles samples from powermetrics output, one line at a
+// time.
+type sampleParser struct {
+	pool            *samplePool
+	modelName       string
+	interval        int // ms, for headers without an elapsed time
+	cpuMetrics      CPUMetrics
+	gpuMetrics      GPUMetrics
+	netdiskMetrics  NetDiskMetrics
+	thermalPressure int
+	columns         taskColumns
+	current         *sample
+	byCPU           processesByCPU // sort.Sort target, reused to avoid allocating
+}
+
+func newSampleParser(pool *samplePool, modelName string, interval int) *sampleParser {
+	return &sampleParser{pool: pool, modelName: modelName, interval: interval, columns: taskColumns{gpu: -1, energy: -1}}
+}
+
+// line parses one line of output. It returns the sample it completes, if
+// any: the thermal pressure line ends each sample, and a header completes a
+// sample that was cut short before it.
+func (p *sampleParser) line(line string) *sample {
+	var complete *sample
+	// Each sample starts with a "*** Sampled system activity" header that is
+	// printed when its interval ends.
+	if strings.HasPrefix(line, "*** Sampled system activity") {
+		complete = p.finish()
+		p.current = p.pool.get()
+		processNames.tick()
+		p.current.Elapsed = float64(p.interval) / 1000
+		if ms, ok := parseElapsed(line); ok {
+			p.current.Elapsed = ms / 1000
+		}
+		if onSampleBoundary != nil {
+			onSampleBoundary(time.Duration(p.current.Elapsed * float64(time.Second)))
+		}
+		p.current.Time = sessionClock.Now()
+	} else if parseTaskHeader(line, &p.columns) {
+		// column layout updated
+	} else if p.current != nil {
+		if pm, ok := parseProcessLine(line, p.columns); ok {
+			p.current.Processes = append(p.current.Processes, pm)
+		}
+	}
+	if level, ok := parseThermalPressure(line); ok {
+		// The thermal sampler prints last, so the sample is complete here
+		// rather than a whole interval later at the next header.
+		p.thermalPressure = level
+		return p.finish()
+	}
+	p.cpuMetrics = parseCPUMetrics(line, p.cpuMetrics, p.modelName)
+	p.gpuMetrics = parseGPUMetrics(line, p.gpuMetrics)
+	p.netdiskMetrics = parseActivityMetrics(line, p.netdiskMetrics)
+	return complete
+}
+
+// finish completes the sample being parsed from the parser state, copied
+// into the sample's own preallocated storage, and returns it (nil before
+// the first header).
+func (p *sampleParser) finish() *sample {
+	s := p.current
+	if s == nil {
+		return nil
+	}
+	p.current = nil
+	eCores, pCores := s.CPU.ECores, s.CPU.PCores
+	s.CPU = p.cpuMetrics
+	s.CPU.ECores = append(eCores[:0], p.cpuMetrics.ECores...)
+	s.CPU.PCores = append(pCores[:0], p.cpuMetrics.PCores...)
+	s.GPU = p.gpuMetrics
+	s.NetDisk = p.netdiskMetrics
+	s.Values = sampleValues(p.cpuMetrics, p.gpuMetrics)
+	s.Values[metricThermalPressure] = float64(p.thermalPressure)
+	p.byCPU = s.Processes
+	sort.Sort(&p.byCPU)
+	p.byCPU = nil
+	return s
+}
+
+// publishSample records a completed sample and hands it to the UI.
+func publishSample(s *sample, samples chan<- *sample) {
+	recordSample(s)
+	s.retain()
+	samples <- s
+	s.release()
+}
+
+// processesByCPU orders processes by CPU usage, highest first, then by pid
+// so ties keep their rows. Sorting through a pointer held by the parser
+// avoids the allocations sort.Slice makes.
+type processesByCPU []ProcessMetrics
+
+func (p *processesByCPU) Len() int { return len(*p) }
+
+func (p *processesByCPU) Less(i, j int) bool {
+	a, b := &(*p)[i], &(*p)[j]
+	if a.CPUUsage != b.CPUUsage {
+		return a.CPUUsage > b.CPUUsage
+	}
+	return a.ID < b.ID
+}
+
+func (p *processesByCPU) Swap(i, j int) { (*p)[i], (*p)[j] = (*p)[j], (*p)[i] }
+
+// recordSample feeds a completed powermetrics sample to the session history
+// and accumulators. It runs on the collector goroutine once per interval.
+func recordSample(s *sample) {
+	sessionMerger.align(s)
+	sessionHistory.append(s)
+	sessionLaps.observe(s)
+	observeSession(s)
+	if sessionBaseline != nil {
+		sessionBaseline.observe(s)
+	}
+	if sessionProfile != nil {
+		sessionProfile.observe(s)
+	}
+	if sessionRecorder != nil {
+		sessionRecorder.observe(s)
+	}
+	for _, e := range emitters {
+		e.observe(s)
 	}
 }
 
 func updateTotalPowerChart(newPowerValue float64) {
-	currentTime := time.Now()
 	powerValues = append(powerValues, newPowerValue)
-	if currentTime.Sub(lastUpdateTime) >= 2*time.Second {
-		var sum float64
-		for _, value := range powerValues {
-			sum += value
-		}
-		averagePower := sum / float64(len(powerValues))
-		averagePower = math.Round(averagePower)
-		TotalPowerChart.Data = append([]float64{averagePower}, TotalPowerChart.Data...)
-		if len(TotalPowerChart.Data) > 25 {
-			TotalPowerChart.Data = TotalPowerChart.Data[:25]
+	if powerPixelChart != nil {
+		now := sessionClock.Now()
+		_, marked := sessionMarkers.labelBetween(lastPixelSample, now)
+		powerPixelChart.add(newPowerValue, marked)
+		lastPixelSample = now
+	}
+}
+
+// rollupTotalPowerChart averages the power readings since the previous call
+// into a new bar, and reports whether it added one. The scheduler calls it
+// every two seconds.
+func rollupTotalPowerChart() bool {
+	currentTime := sessionClock.Now()
+	if len(powerValues) == 0 || powerPixelChart != nil { // the bitmap chart replaces the bars
+		powerValues = powerValues[:0]
+		return false
+	}
+	averagePower := sumFloat64(powerValues) / float64(len(powerValues))
+	averagePower = math.Round(averagePower)
+	TotalPowerChart.Data = append([]float64{averagePower}, TotalPowerChart.Data...)
+	// Markers added since the previous bar show up as a tick under the new bar.
+	tick := ""
+	if label, ok := sessionMarkers.labelBetween(lastUpdateTime, currentTime); ok {
+		tick = "|" + label
+		if len(tick) > TotalPowerChart.BarWidth {
+			tick = tick[:TotalPowerChart.BarWidth]
 		}
-		powerValues = nil
-		lastUpdateTime = currentTime
 	}
+	TotalPowerChart.Labels = append([]string{tick}, TotalPowerChart.Labels...)
+	if len(TotalPowerChart.Data) > 25 {
+		TotalPowerChart.Data = TotalPowerChart.Data[:25]
+		TotalPowerChart.Labels = TotalPowerChart.Labels[:25]
+	}
+	powerValues = powerValues[:0]
+	lastUpdateTime = currentTime
+	return true
 }
 
 func updateCPUUI(cpuMetrics CPUMetrics) {
@@ -531,8 +1105,22 @@ func updateCPUUI(cpuMetrics CPUMetrics) {
 	TotalPowerChart.Title = fmt.Sprintf("%.1f W Total Power", cpuMetrics.PackageW)
 	PowerChart.Title = fmt.Sprintf("%.1f W CPU - %.1f W GPU", cpuMetrics.CPUW, cpuMetrics.GPUW)
 	PowerChart.Text = fmt.Sprintf("CPU Power: %.1f W\nGPU Power: %.1f W\nANE Power: %.1f W\nTotal Power: %.1f W", cpuMetrics.CPUW, cpuMetrics.GPUW, cpuMetrics.ANEW, cpuMetrics.PackageW)
-	memoryMetrics := getMemoryMetrics()
+	if battery := batteryText(cpuMetrics.PackageW); battery != "" {
+		PowerChart.Text += "\n" + battery
+	}
+	if status := sessionLaps.status(); status != "" {
+		PowerChart.Text += "\n" + status
+	}
+}
+
+func updateMemoryUI(memoryMetrics MemoryMetrics, age time.Duration, stale bool) {
+	if memoryMetrics.Total == 0 {
+		return // no reading yet
+	}
 	memoryGauge.Title = fmt.Sprintf("Memory Usage: %.2f GB / %.2f GB (Swap: %.2f/%.2f GB)", float64(memoryMetrics.Used)/1024/1024/1024, float64(memoryMetrics.Total)/1024/1024/1024, float64(memoryMetrics.SwapUsed)/1024/1024/1024, float64(memoryMetrics.SwapTotal)/1024/1024/1024)
+	if stale {
+		memoryGauge.Title += fmt.Sprintf(" [stale %s]", age.Round(time.Second))
+	}
 	memoryGauge.Percent = int((float64(memoryMetrics.Used) / float64(memoryMetrics.Total)) * 100)
 }
 
@@ -546,114 +1134,188 @@ func updateNetDiskUI(netdiskMetrics NetDiskMetrics) {
 }
 
 func updateProcessUI(processMetrics []ProcessMetrics) {
-	ProcessInfo.Text = ""
-	sort.Slice(processMetrics, func(i, j int) bool {
-		return processMetrics[i].CPUUsage > processMetrics[j].CPUUsage
-	})
-	maxEntries := 15
-	if len(processMetrics) > maxEntries {
-		processMetrics = processMetrics[:maxEntries]
+	processHistory.update(processMetrics, procTableRows)
+	if len(processMetrics) > procTableRows {
+		processMetrics = processMetrics[:procTableRows]
 	}
+	var sb strings.Builder
 	for _, pm := range processMetrics {
-		ProcessInfo.Text += fmt.Sprintf("%d - %s: %.2f ms/s\n", pm.ID, pm.Name, pm.CPUUsage)
+		fmt.Fprintf(&sb, "%s %d - %s: %.2f ms/s\n", processHistory.sparkline(procKey{pm.ID, pm.Name}), pm.ID, pm.Name, pm.CPUUsage)
 	}
+	ProcessInfo.Text = sb.String()
 }
 
-func parseProcessMetrics(powermetricsOutput string, processMetrics []ProcessMetrics) []ProcessMetrics {
-	lines := strings.Split(powermetricsOutput, "\n")
-	seen := make(map[int]bool) // Map to track seen process IDs
-	for _, line := range lines {
-		matches := dataRegex.FindStringSubmatch(line)
-		if len(matches) > 3 {
-			processName := matches[1]
-			if processName == "mactop" || processName == "main" || processName == "powermetrics" {
-				continue // Skip this process
-			}
-			id, _ := strconv.Atoi(matches[2])
-			if !seen[id] {
-				seen[id] = true
-				cpuMsPerS, _ := strconv.ParseFloat(matches[3], 64)
-				processMetrics = append(processMetrics, ProcessMetrics{
-					Name:     matches[1],
-					ID:       id,
-					CPUUsage: cpuMsPerS,
-				})
-			}
+// taskColumns locates optional columns of the powermetrics task table, as
+// value slots counted from the first column after ID. -1 when absent.
+type taskColumns struct {
+	gpu, energy int
+}
+
+// parseTaskHeader recognizes the task table header and records where the
+// GPU and energy columns are. Multi-value headers such as
+// "Wakeups (Intr, Pkg idle)" span one slot per comma-separated value.
+func parseTaskHeader(line string, columns *taskColumns) bool {
+	trimmed := strings.TrimSpace(line)
+	if !strings.HasPrefix(trimmed, "Name") || !strings.Contains(trimmed, "CPU ms/s") {
+		return false
+	}
+	*columns = taskColumns{gpu: -1, energy: -1}
+	slot := 0
+	for i, rest := 0, trimmed; rest != ""; i++ {
+		var title string
+		title, rest = cutColumn(rest)
+		if i < 2 {
+			continue // Name and ID
 		}
+		switch title {
+		case "GPU ms/s":
+			columns.gpu = slot
+		case "Energy Impact":
+			columns.energy = slot
+		}
+		slot += 1 + strings.Count(title, ",")
 	}
+	return true
+}
 
-	sort.Slice(processMetrics, func(i, j int) bool {
-		return processMetrics[i].CPUUsage > processMetrics[j].CPUUsage
-	})
-	return processMetrics
+// cutColumn splits the first title off a table header whose columns are
+// separated by two or more spaces.
+func cutColumn(s string) (title, rest string) {
+	for i := 0; i+1 < len(s); i++ {
+		if isSpace(s[i]) && isSpace(s[i+1]) {
+			return s[:i], strings.TrimLeft(s[i:], " \t")
+		}
+	}
+	return s, ""
 }
 
-func parseActivityMetrics(powermetricsOutput string, netdiskMetrics NetDiskMetrics) NetDiskMetrics {
+// parseProcessLine parses one row of the powermetrics task table. Names may
+// contain spaces, so the name runs up to the first field that is followed by
+// a PID and two decimals (CPU ms/s and User%).
+func parseProcessLine(line string, columns taskColumns) (ProcessMetrics, bool) {
+	nameStart, nameEnd := nextField(line, 0)
+	if nameStart == nameEnd {
+		return ProcessMetrics{}, false
+	}
+	var idStart, idEnd, cpuStart, cpuEnd int
+	for {
+		var userStart, userEnd int
+		idStart, idEnd = nextField(line, nameEnd)
+		cpuStart, cpuEnd = nextField(line, idEnd)
+		userStart, userEnd = nextField(line, cpuEnd)
+		if userStart == userEnd {
+			return ProcessMetrics{}, false
+		}
+		if userEnd < len(line) && isDigits(line[idStart:idEnd]) && isDecimal(line[cpuStart:cpuEnd]) && isDecimal(line[userStart:userEnd]) {
+			break
+		}
+		nameEnd = idEnd
+	}
+	processName := line[nameStart:nameEnd]
+	if processName == "mactop" || processName == "main" || processName == "powermetrics" {
+		return ProcessMetrics{}, false // Skip this process
+	}
+	processName = processNames.intern(processName) // line may alias the scanner buffer
+	id, _ := strconv.Atoi(line[idStart:idEnd])
+	cpuMsPerS, _ := strconv.ParseFloat(line[cpuStart:cpuEnd], 64)
+	pm := ProcessMetrics{
+		Name:     processName,
+		ID:       id,
+		CPUUsage: cpuMsPerS,
+	}
+	values := line[idEnd:]
+	if field, ok := nthField(values, columns.gpu); ok && columns.gpu >= 0 {
+		pm.GPUUsage, _ = strconv.ParseFloat(field, 64)
+	}
+	if field, ok := nthField(values, columns.energy); ok && columns.energy >= 0 {
+		pm.EnergyImpact, _ = strconv.ParseFloat(field, 64)
+	}
+	return pm, true
+}
+
+var thermalLevels = []string{"Nominal", "Moderate", "Heavy", "Trapping", "Sleeping"}
 
-	outMatches := outRegex.FindStringSubmatch(powermetricsOutput)
-	inMatches := inRegex.FindStringSubmatch(powermetricsOutput)
-	if len(outMatches) == 3 {
-		netdiskMetrics.OutPacketsPerSec, _ = strconv.ParseFloat(outMatches[1], 64)
-		netdiskMetrics.OutBytesPerSec, _ = strconv.ParseFloat(outMatches[2], 64)
+// parseThermalPressure reads the thermal sampler's pressure level, 0 for
+// Nominal up to 4 for Sleeping. It reports whether line named a known
+// level, so a line cut short by a crash does not count.
+func parseThermalPressure(line string) (int, bool) {
+	rest, ok := strings.CutPrefix(line, "Current pressure level: ")
+	if !ok {
+		return 0, false
 	}
-	if len(inMatches) == 3 {
-		netdiskMetrics.InPacketsPerSec, _ = strconv.ParseFloat(inMatches[1], 64)
-		netdiskMetrics.InBytesPerSec, _ = strconv.ParseFloat(inMatches[2], 64)
+	for i, name := range thermalLevels {
+		if strings.TrimSpace(rest) == name {
+			return i, true
+		}
 	}
+	return 0, false
+}
 
-	readMatches := readRegex.FindStringSubmatch(powermetricsOutput)
-	writeMatches := writeRegex.FindStringSubmatch(powermetricsOutput)
-	if len(readMatches) == 3 {
-		netdiskMetrics.ReadOpsPerSec, _ = strconv.ParseFloat(readMatches[1], 64)
-		netdiskMetrics.ReadKBytesPerSec, _ = strconv.ParseFloat(readMatches[2], 64)
+func parseActivityMetrics(powermetricsOutput string, netdiskMetrics NetDiskMetrics) NetDiskMetrics {
+	if a, b, ok := parseRates(powermetricsOutput, "out:", "packets/s,", "bytes/s"); ok {
+		netdiskMetrics.OutPacketsPerSec, netdiskMetrics.OutBytesPerSec = a, b
+	}
+	if a, b, ok := parseRates(powermetricsOutput, "in:", "packets/s,", "bytes/s"); ok {
+		netdiskMetrics.InPacketsPerSec, netdiskMetrics.InBytesPerSec = a, b
+	}
+	if a, b, ok := parseRates(powermetricsOutput, "read:", "ops/s", "KBytes/s"); ok {
+		netdiskMetrics.ReadOpsPerSec, netdiskMetrics.ReadKBytesPerSec = a, b
 	}
-	if len(writeMatches) == 3 {
-		netdiskMetrics.WriteOpsPerSec, _ = strconv.ParseFloat(writeMatches[1], 64)
-		netdiskMetrics.WriteKBytesPerSec, _ = strconv.ParseFloat(writeMatches[2], 64)
+	if a, b, ok := parseRates(powermetricsOutput, "write:", "ops/s", "KBytes/s"); ok {
+		netdiskMetrics.WriteOpsPerSec, netdiskMetrics.WriteKBytesPerSec = a, b
 	}
 	return netdiskMetrics
 }
 
+// parseRates reads a "<key> <a> <unitA> <b> <unitB>" rate line such as
+// "out: 12.00 packets/s, 3400.00 bytes/s".
+func parseRates(line, key, unitA, unitB string) (a, b float64, ok bool) {
+	_, rest, found := strings.Cut(line, key)
+	if !found {
+		return 0, 0, false
+	}
+	x, rest := cutNumber(rest)
+	rest, okA := strings.CutPrefix(strings.TrimLeft(rest, " \t"), unitA)
+	y, rest := cutNumber(rest)
+	if x == "" || y == "" || !okA || !strings.HasPrefix(strings.TrimLeft(rest, " \t"), unitB) {
+		return 0, 0, false
+	}
+	a, _ = strconv.ParseFloat(x, 64)
+	b, _ = strconv.ParseFloat(y, 64)
+	return a, b, true
+}
+
 func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName string) CPUMetrics {
-	lines := strings.Split(powermetricsOutput, "\n")
-	eCores := []int{}
-	pCores := []int{}
+	eCores := cpuMetrics.ECores[:0]
+	pCores := cpuMetrics.PCores[:0]
 	var eClusterActiveSum, pClusterActiveSum, eClusterFreqSum, pClusterFreqSum float64
 	var eClusterCount, pClusterCount, eClusterActiveTotal, pClusterActiveTotal, eClusterFreqTotal, pClusterFreqTotal int
 
 	if modelName == "Apple M3 Max" || modelName == "Apple M2 Max" { // For the M3/M2 Max, we need to manually parse the CPU Usage from the powermetrics output (as current bug in Apple's powermetrics)
-		for _, line := range lines {
+		for rest := powermetricsOutput; rest != ""; {
+			var line string
+			line, rest, _ = strings.Cut(rest, "\n")
 
 			maxCores := 15 // 16 Cores for M3 Max (4+12)
 			if modelName == "Apple M2 Max" {
 				maxCores = 11 // 12 Cores M2 Max (4+8)
 			}
-			for i := 0; i <= maxCores; i++ {
-				re := regexp.MustCompile(`CPU ` + strconv.Itoa(i) + ` active residency:\s+(\d+\.\d+)%`)
-				matches := re.FindStringSubmatch(powermetricsOutput)
-				if len(matches) > 1 {
-					activeResidency, _ := strconv.ParseFloat(matches[1], 64)
-					if i <= 3 {
-						eClusterActiveSum += activeResidency
-						eClusterCount++
-					} else {
-						pClusterActiveSum += activeResidency
-						pClusterCount++
-					}
+			if i, activeResidency, ok := parseCoreResidency(line); ok && i <= maxCores {
+				if i <= 3 {
+					eClusterActiveSum += activeResidency
+					eClusterCount++
+				} else {
+					pClusterActiveSum += activeResidency
+					pClusterCount++
 				}
 			}
-			for i := 0; i <= maxCores; i++ {
-				fre := regexp.MustCompile(`^CPU\s+` + strconv.Itoa(i) + `\s+frequency:\s+(\d+)\s+MHz$`)
-				matches := fre.FindStringSubmatch(powermetricsOutput)
-				if len(matches) > 1 {
-					activeFreq, _ := strconv.ParseFloat(matches[1], 64)
-					if i <= 3 {
-						eClusterFreqSum += activeFreq
-						eClusterCount++
-					} else {
-						pClusterFreqSum += activeFreq
-						pClusterCount++
-					}
+			if i, activeFreq, ok := parseCoreFrequency(line); ok && i <= maxCores {
+				if i <= 3 {
+					eClusterFreqSum += activeFreq
+					eClusterCount++
+				} else {
+					pClusterFreqSum += activeFreq
+					pClusterCount++
 				}
 			}
 
@@ -671,9 +1333,8 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 			}
 
 			if strings.Contains(line, "CPU ") && strings.Contains(line, "frequency") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					core, _ := strconv.Atoi(strings.TrimPrefix(fields[1], "CPU"))
+				if field, ok := nthField(line, 1); ok {
+					core, _ := strconv.Atoi(strings.TrimPrefix(field, "CPU"))
 					if strings.Contains(line, "E-Cluster") {
 						eCores = append(eCores, core)
 					} else if strings.Contains(line, "P-Cluster") {
@@ -681,27 +1342,23 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 					}
 				}
 			} else if strings.Contains(line, "ANE Power") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					cpuMetrics.ANEW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[2], "mW"), 64)
+				if field, ok := nthField(line, 2); ok {
+					cpuMetrics.ANEW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.ANEW /= 1000 // Convert mW to W
 				}
 			} else if strings.Contains(line, "CPU Power") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					cpuMetrics.CPUW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[2], "mW"), 64)
+				if field, ok := nthField(line, 2); ok {
+					cpuMetrics.CPUW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.CPUW /= 1000 // Convert mW to W
 				}
 			} else if strings.Contains(line, "GPU Power") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					cpuMetrics.GPUW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[2], "mW"), 64)
+				if field, ok := nthField(line, 2); ok {
+					cpuMetrics.GPUW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.GPUW /= 1000 // Convert mW to W
 				}
 			} else if strings.Contains(line, "Combined Power (CPU + GPU + ANE)") {
-				fields := strings.Fields(line)
-				if len(fields) >= 8 {
-					cpuMetrics.PackageW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[7], "mW"), 64)
+				if field, ok := nthField(line, 7); ok {
+					cpuMetrics.PackageW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.PackageW /= 1000 // Convert mW to W
 				}
 			}
@@ -709,13 +1366,11 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 		cpuMetrics.ECores = eCores
 		cpuMetrics.PCores = pCores
 	} else {
-		for _, line := range lines {
-			residencyMatches := residencyRe.FindStringSubmatch(line)
-			frequencyMatches := frequencyRe.FindStringSubmatch(line)
-
-			if residencyMatches != nil {
-				cluster := residencyMatches[1]
-				percent, _ := strconv.ParseFloat(residencyMatches[2], 64)
+		for rest := powermetricsOutput; rest != ""; {
+			var line string
+			line, rest, _ = strings.Cut(rest, "\n")
+			if cluster, value, unit, ok := cutClusterStat(line, " HW active residency:"); ok && isDecimal(value) && strings.HasPrefix(unit, "%") {
+				percent, _ := strconv.ParseFloat(value, 64)
 				switch cluster {
 				case "E0-Cluster":
 					cpuMetrics.E0ClusterActive = int(percent)
@@ -740,9 +1395,8 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 				}
 			}
 
-			if frequencyMatches != nil {
-				cluster := frequencyMatches[1]
-				freqMHz, _ := strconv.Atoi(frequencyMatches[2])
+			if cluster, value, unit, ok := cutClusterStat(line, " HW active frequency:"); ok && isDigits(value) && strings.HasPrefix(strings.TrimLeft(unit, " \t"), "MHz") {
+				freqMHz, _ := strconv.Atoi(value)
 				switch cluster {
 				case "E0-Cluster":
 					cpuMetrics.E0ClusterFreqMHz = freqMHz
@@ -767,9 +1421,8 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 			}
 
 			if strings.Contains(line, "CPU ") && strings.Contains(line, "frequency") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					core, _ := strconv.Atoi(strings.TrimPrefix(fields[1], "CPU"))
+				if field, ok := nthField(line, 1); ok {
+					core, _ := strconv.Atoi(strings.TrimPrefix(field, "CPU"))
 					if strings.Contains(line, "E-Cluster") {
 						eCores = append(eCores, core)
 					} else if strings.Contains(line, "P-Cluster") {
@@ -777,27 +1430,23 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 					}
 				}
 			} else if strings.Contains(line, "ANE Power") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					cpuMetrics.ANEW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[2], "mW"), 64)
+				if field, ok := nthField(line, 2); ok {
+					cpuMetrics.ANEW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.ANEW /= 1000 // Convert mW to W
 				}
 			} else if strings.Contains(line, "CPU Power") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					cpuMetrics.CPUW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[2], "mW"), 64)
+				if field, ok := nthField(line, 2); ok {
+					cpuMetrics.CPUW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.CPUW /= 1000 // Convert mW to W
 				}
 			} else if strings.Contains(line, "GPU Power") {
-				fields := strings.Fields(line)
-				if len(fields) >= 3 {
-					cpuMetrics.GPUW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[2], "mW"), 64)
+				if field, ok := nthField(line, 2); ok {
+					cpuMetrics.GPUW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.GPUW /= 1000 // Convert mW to W
 				}
 			} else if strings.Contains(line, "Combined Power (CPU + GPU + ANE)") {
-				fields := strings.Fields(line)
-				if len(fields) >= 8 {
-					cpuMetrics.PackageW, _ = strconv.ParseFloat(strings.TrimSuffix(fields[7], "mW"), 64)
+				if field, ok := nthField(line, 7); ok {
+					cpuMetrics.PackageW, _ = strconv.ParseFloat(strings.TrimSuffix(field, "mW"), 64)
 					cpuMetrics.PackageW /= 1000 // Convert mW to W
 				}
 			}
@@ -829,6 +1478,139 @@ func parseCPUMetrics(powermetricsOutput string, cpuMetrics CPUMetrics, modelName
 	return cpuMetrics
 }
 
+// nthField returns the n-th (0-based) whitespace-separated field of line
+// without allocating the full strings.Fields slice.
+func nthField(line string, n int) (string, bool) {
+	for i := 0; ; i++ {
+		line = strings.TrimLeft(line, " \t")
+		if line == "" {
+			return "", false
+		}
+		end := strings.IndexAny(line, " \t")
+		if end < 0 {
+			end = len(line)
+		}
+		if i == n {
+			return line[:end], true
+		}
+		line = line[end:]
+	}
+}
+
+func isSpace(c byte) bool {
+	return c == ' ' || c == '\t'
+}
+
+// nextField returns the bounds of the first whitespace-separated field of
+// line at or after off; start == end when there is none.
+func nextField(line string, off int) (start, end int) {
+	for off < len(line) && isSpace(line[off]) {
+		off++
+	}
+	start = off
+	for off < len(line) && !isSpace(line[off]) {
+		off++
+	}
+	return start, off
+}
+
+func isDigits(s string) bool {
+	for i := 0; i < len(s); i++ {
+		if s[i] < '0' || s[i] > '9' {
+			return false
+		}
+	}
+	return s != ""
+}
+
+// isDecimal reports whether s has the form digits.digits.
+func isDecimal(s string) bool {
+	i := strings.IndexByte(s, '.')
+	return i > 0 && isDigits(s[:i]) && isDigits(s[i+1:])
+}
+
+// cutNumber splits the run of digits and dots that starts s, after any
+// leading whitespace, from the rest.
+func cutNumber(s string) (num, rest string) {
+	s = strings.TrimLeft(s, " \t")
+	i := 0
+	for i < len(s) && (s[i] >= '0' && s[i] <= '9' || s[i] == '.') {
+		i++
+	}
+	return s[:i], s[i:]
+}
+
+// trailingDigits returns the run of digits that ends s.
+func trailingDigits(s string) string {
+	i := len(s)
+	for i > 0 && s[i-1] >= '0' && s[i-1] <= '9' {
+		i--
+	}
+	return s[i:]
+}
+
+// parseElapsed reads the interval length from a sample header's
+// "(1003.21ms elapsed)".
+func parseElapsed(line string) (float64, bool) {
+	before, _, ok := strings.Cut(line, "ms elapsed)")
+	if !ok {
+		return 0, false
+	}
+	num := before[strings.LastIndexByte(before, '(')+1:]
+	if !isDecimal(num) {
+		return 0, false
+	}
+	ms, _ := strconv.ParseFloat(num, 64)
+	return ms, true
+}
+
+// cutClusterStat reads a "<name>-Cluster<stat> <value>" line, e.g.
+// "P0-Cluster HW active residency:  41.20% (...)", returning the cluster
+// name, the number and what follows it.
+func cutClusterStat(line, stat string) (cluster, value, rest string, ok bool) {
+	before, after, found := strings.Cut(line, stat)
+	if !found || !strings.HasSuffix(before, "-Cluster") {
+		return "", "", "", false
+	}
+	cluster = before[strings.LastIndexAny(before, " \t")+1:]
+	if cluster == "-Cluster" {
+		return "", "", "", false
+	}
+	value, rest = cutNumber(after)
+	return cluster, value, rest, true
+}
+
+// parseCoreResidency reads "CPU <n> active residency: <x>% (...)".
+func parseCoreResidency(line string) (int, float64, bool) {
+	before, after, found := strings.Cut(line, " active residency:")
+	if !found {
+		return 0, 0, false
+	}
+	n := trailingDigits(before)
+	value, rest := cutNumber(after)
+	if n == "" || !strings.HasSuffix(before[:len(before)-len(n)], "CPU ") || !isDecimal(value) || !strings.HasPrefix(rest, "%") {
+		return 0, 0, false
+	}
+	core, _ := strconv.Atoi(n)
+	v, _ := strconv.ParseFloat(value, 64)
+	return core, v, true
+}
+
+// parseCoreFrequency reads a "CPU <n> frequency: <x> MHz" line.
+func parseCoreFrequency(line string) (int, float64, bool) {
+	cpu, _ := nthField(line, 0)
+	n, _ := nthField(line, 1)
+	label, _ := nthField(line, 2)
+	value, _ := nthField(line, 3)
+	unit, _ := nthField(line, 4)
+	if _, extra := nthField(line, 5); extra || cpu != "CPU" || label != "frequency:" || unit != "MHz" || !isDigits(n) || !isDigits(value) {
+		return 0, 0, false
+	}
+	core, _ := strconv.Atoi(n)
+	v, _ := strconv.ParseFloat(value, 64)
+	return core, v, true
+}
+
 func max(nums ...int) int {
 	maxVal := nums[0]
 	for _, num := range nums[1:] {
@@ -840,29 +1622,37 @@ func max(nums ...int) int {
 }
 
 func parseGPUMetrics(powermetricsOutput string, gpuMetrics GPUMetrics) GPUMetrics {
-
-	lines := strings.Split(powermetricsOutput, "\n")
-
-	for _, line := range lines {
+	for rest := powermetricsOutput; rest != ""; {
+		var line string
+		line, rest, _ = strings.Cut(rest, "\n")
 		if strings.Contains(line, "GPU active") || strings.Contains(line, "GPU HW active") {
-			matches := re.FindStringSubmatch(line)
-			if len(matches) > 3 {
-				if strings.Contains(matches[2], "residency") {
-					gpuMetrics.Active, _ = strconv.ParseFloat(matches[3], 64)
-				} else if strings.Contains(matches[2], "frequency") {
-					gpuMetrics.FreqMHz, _ = strconv.Atoi(strings.TrimSuffix(matches[3], "MHz"))
+			if _, after, ok := strings.Cut(line, "active residency:"); ok {
+				if value, _ := cutNumber(after); isDecimal(value) {
+					gpuMetrics.Active, _ = strconv.ParseFloat(value, 64)
+				}
+			} else if _, after, ok := strings.Cut(line, "active frequency:"); ok {
+				if value, _ := cutNumber(after); value != "" {
+					mhz, _ := strconv.ParseFloat(value, 64)
+					gpuMetrics.FreqMHz = int(mhz)
 				}
 			}
 
-			freqMatches := freqRe.FindAllStringSubmatch(line, -1)
-			for _, match := range freqMatches {
-				if len(match) == 3 {
-					freq, _ := strconv.Atoi(match[1])
-					residency, _ := strconv.ParseFloat(match[2], 64)
-					if residency > 0 {
-						gpuMetrics.FreqMHz = freq
-						break
-					}
+			// The residency line breaks it down by frequency,
+			// "(389 MHz: 0% 486 MHz: 12% ...)"; take the lowest one in use.
+			for rest := line; ; {
+				before, after, ok := strings.Cut(rest, "MHz:")
+				if !ok {
+					break
+				}
+				rest = after
+				mhz := trailingDigits(strings.TrimRight(before, " \t"))
+				pct, tail := cutNumber(after)
+				if mhz == "" || pct == "" || !strings.HasPrefix(tail, "%") {
+					continue
+				}
+				if residency, _ := strconv.ParseFloat(pct, 64); residency > 0 {
+					gpuMetrics.FreqMHz, _ = strconv.Atoi(mhz)
+					break
 				}
 			}
 		}
@@ -871,7 +1661,21 @@ func parseGPUMetrics(powermetricsOutput string, gpuMetrics GPUMetrics) GPUMetric
 	return gpuMetrics
 }
 
+// getSOCInfo describes the chip. The commands behind it take seconds
+// (system_profiler above all) and the answer cannot change while we run, so
+// it is computed once.
 func getSOCInfo() map[string]interface{} {
+	socInfoOnce.Do(func() { socInfo = readSOCInfo() })
+	return socInfo
+}
+
+var (
+	socInfoOnce sync.Once
+	socInfo     map[string]interface{}
+)
+
+func readSOCInfo() map[string]interface{} {
+	defer startupTrace.phase("getSOCInfo", time.Now())
 	cpuInfoDict := getCPUInfo()
 	coreCountsDict := getCoreCounts()
 	var eCoreCounts, pCoreCounts int
@@ -882,19 +1686,31 @@ func getSOCInfo() map[string]interface{} {
 	if val, ok := coreCountsDict["hw.perflevel0.logicalcpu"]; ok {
 		pCoreCounts = val
 	}
-	socInfo := map[string]interface{}{
-		"name":           cpuInfoDict["machdep.cpu.brand_string"],
-		"core_count":     cpuInfoDict["machdep.cpu.core_count"],
+	hw := hardwareProfile{
+		Name:      cpuInfoDict["machdep.cpu.brand_string"],
+		CoreCount: cpuInfoDict["machdep.cpu.core_count"],
+		ECores:    eCoreCounts,
+		PCores:    pCoreCounts,
+	}
+	if cached, ok := readHardwareCache(); ok && cached.Name == hw.Name && cached.CoreCount == hw.CoreCount && cached.ECores == hw.ECores && cached.PCores == hw.PCores {
+		hw.GPUCores = cached.GPUCores
+	} else {
+		hw.GPUCores = getGPUCores()
+		writeHardwareCache(hw)
+	}
+	info := map[string]interface{}{
+		"name":           hw.Name,
+		"core_count":     hw.CoreCount,
 		"cpu_max_power":  nil,
 		"gpu_max_power":  nil,
 		"cpu_max_bw":     nil,
 		"gpu_max_bw":     nil,
-		"e_core_count":   eCoreCounts,
-		"p_core_count":   pCoreCounts,
-		"gpu_core_count": getGPUCores(),
+		"e_core_count":   hw.ECores,
+		"p_core_count":   hw.PCores,
+		"gpu_core_count": hw.GPUCores,
 	}
 
-	return socInfo
+	return info
 }
 
 func getMemoryMetrics() MemoryMetrics {
@@ -917,6 +1733,7 @@ func getMemoryMetrics() MemoryMetrics {
 }
 
 func getCPUInfo() map[string]string {
+	defer startupTrace.phase("getSOCInfo: sysctl machdep.cpu", time.Now())
 	out, err := exec.Command("sysctl", "machdep.cpu").Output()
 	if err != nil {
 		stderrLogger.Fatalf("failed to execute getCPUInfo() sysctl command: %v", err)
@@ -939,6 +1756,7 @@ func getCPUInfo() map[string]string {
 }
 
 func getCoreCounts() map[string]int {
+	defer startupTrace.phase("getSOCInfo: sysctl hw.perflevel", time.Now())
 	out, err := exec.Command("sysctl", "hw.perflevel0.logicalcpu", "hw.perflevel1.logicalcpu").Output()
 	if err != nil {
 		stderrLogger.Fatalf("failed to execute getCoreCounts() sysctl command: %v", err)
@@ -961,12 +1779,12 @@ func getCoreCounts() map[string]int {
 }
 
 func getGPUCores() string {
+	defer startupTrace.phase("getSOCInfo: system_profiler", time.Now())
 	cmd, err := exec.Command("system_profiler", "-detailLevel", "basic", "SPDisplaysDataType").Output()
 	if err != nil {
 		stderrLogger.Fatalf("failed to execute system_profiler command: %v", err)
 	}
 	output := string(cmd)
-	stderrLogger.Printf("Output: %s\n", output)
 	lines := strings.Split(output, "\n")
 	for _, line := range lines {
 		if strings.Contains(line, "Total Number of Cores") {
@@ -0,0 +1,278 @@
+package main
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+const (
+	markerSocketPath = "/var/run/mactop.sock"
+	maxMarkers       = 4096
+	maxMarkerLabel   = 1024                  // bytes; recordings store label lengths as uint16
+	maxMarkerLine    = 2*maxMarkerLabel + 64 // a summary command names two labels
+	maxMarkerConns   = 16
+)
+
+type marker struct {
+	Time  time.Time
+	Label string
+}
+
+// markerLog holds the named markers injected into the running session.
+type markerLog struct {
+	mu    sync.Mutex
+	items []marker
+}
+
+func (m *markerLog) add(label string) marker {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	mk := marker{Time: sessionClock.Now(), Label: label}
+	if len(m.items) >= maxMarkers {
+		m.items = append(m.items[:0], m.items[1:]...)
+	}
+	m.items = append(m.items, mk)
+	return mk
+}
+
+func (m *markerLog) snapshot() []marker {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	return append([]marker(nil), m.items...)
+}
+
+// find returns the most recent marker with the given label.
+func (m *markerLog) find(label string) (marker, bool) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	for i := len(m.items) - 1; i >= 0; i-- {
+		if m.items[i].Label == label {
+			return m.items[i], true
+		}
+	}
+	return marker{}, false
+}
+
+// between returns the markers in (from, to], oldest first.
+func (m *markerLog) between(from, to time.Time) []marker {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	var out []marker
+	for _, mk := range m.items {
+		if mk.Time.After(from) && !mk.Time.After(to) {
+			out = append(out, mk)
+		}
+	}
+	return out
+}
+
+// labelBetween returns the label of the latest marker in (from, to], if any.
+func (m *markerLog) labelBetween(from, to time.Time) (string, bool) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	for i := len(m.items) - 1; i >= 0; i-- {
+		t := m.items[i].Time
+		if t.After(to) {
+			continue
+		}
+		if !t.After(from) {
+			break
+		}
+		return m.items[i].Label, true
+	}
+	return "", false
+}
+
+var sessionMarkers markerLog
+
+// serveMarkers accepts one-line commands from `mactop mark` and friends:
+//
+//	mark <label>        record a marker now
+//	summary             summarize every phase between consecutive markers
+//	summary <from> <to> summarize the samples between two named markers
+func serveMarkers(path string) (net.Listener, error) {
+	os.Remove(path) // stale socket from a previous run
+	ln, err := net.Listen("unix", path)
+	if err != nil {
+		return nil, fmt.Errorf("failed to listen on %s: %v", path, err)
+	}
+	// Let unprivileged CI scripts mark phases of a sudo mactop session.
+	if err := os.Chmod(path, 0666); err != nil {
+		stderrLogger.Printf("failed to chmod %s: %v", path, err)
+	}
+	go func() {
+		// Bound the handlers; further clients wait in the listen backlog.
+		sem := make(chan struct{}, maxMarkerConns)
+		for {
+			sem <- struct{}{}
+			conn, err := ln.Accept()
+			if err != nil {
+				return
+			}
+			go func() {
+				defer func() { <-sem }()
+				handleMarkerConn(conn)
+			}()
+		}
+	}()
+	return ln, nil
+}
+
+func handleMarkerConn(conn net.Conn) {
+	defer conn.Close()
+	conn.SetDeadline(time.Now().Add(5 * time.Second))
+	sc := bufio.NewScanner(conn)
+	sc.Buffer(make([]byte, 0, 256), maxMarkerLine)
+	if !sc.Scan() {
+		if sc.Err() == bufio.ErrTooLong {
+			fmt.Fprintf(conn, "error: command longer than %d bytes\n", maxMarkerLine)
+		}
+		return
+	}
+	cmd, arg, _ := strings.Cut(strings.TrimSpace(sc.Text()), " ")
+	switch cmd {
+	case "mark":
+		if arg == "" {
+			fmt.Fprintln(conn, "error: marker label required")
+			return
+		}
+		if len(arg) > maxMarkerLabel {
+			fmt.Fprintf(conn, "error: marker label longer than %d bytes\n", maxMarkerLabel)
+			return
+		}
+		mk := sessionMarkers.add(arg)
+		if sessionRecorder != nil {
+			sessionRecorder.mark(mk)
+		}
+		fmt.Fprintf(conn, "ok %s %s\n", mk.Time.Format(time.RFC3339Nano), mk.Label)
+	case "summary":
+		labels, err := parseQuotedLabels(arg)
+		if err != nil || (len(labels) != 0 && len(labels) != 2) {
+			fmt.Fprintln(conn, "error: summary takes no labels or two quoted labels")
+			return
+		}
+		writeMarkerSummary(conn, labels)
+	default:
+		fmt.Fprintf(conn, "error: unknown command %q\n", cmd)
+	}
+}
+
+// parseQuotedLabels splits a list of Go-quoted strings, so labels may
+// contain spaces.
+func parseQuotedLabels(s string) ([]string, error) {
+	var labels []string
+	for s = strings.TrimSpace(s); s != ""; s = strings.TrimSpace(s) {
+		q, err := strconv.QuotedPrefix(s)
+		if err != nil {
+			return nil, err
+		}
+		label, _ := strconv.Unquote(q)
+		labels = append(labels, label)
+		s = s[len(q):]
+	}
+	return labels, nil
+}
+
+// writeMarkerSummary prints every marker phase, or the range between two
+// labels when args holds them.
+func writeMarkerSummary(out io.Writer, args []string) {
+	type phase struct {
+		name     string
+		from, to time.Time
+	}
+	var phases []phase
+	if len(args) == 2 {
+		from, ok := sessionMarkers.find(args[0])
+		if !ok {
+			fmt.Fprintf(out, "error: no marker named %q\n", args[0])
+			return
+		}
+		to, ok := sessionMarkers.find(args[1])
+		if !ok {
+			fmt.Fprintf(out, "error: no marker named %q\n", args[1])
+			return
+		}
+		phases = append(phases, phase{from.Label + ".." + to.Label, from.Time, to.Time})
+	} else {
+		// Each marker opens a phase that runs until the next one (or now).
+		markers := sessionMarkers.snapshot()
+		for i, mk := range markers {
+			end := sessionClock.Now()
+			if i+1 < len(markers) {
+				end = markers[i+1].Time
+			}
+			phases = append(phases, phase{mk.Label, mk.Time, end})
+		}
+	}
+	if len(phases) == 0 {
+		fmt.Fprintln(out, "no markers recorded")
+		return
+	}
+	fmt.Fprintf(out, "%-24s %10s %7s %9s %9s %9s %9s %7s %7s %7s\n", "phase", "duration", "samples", "pkg J", "cpu J", "gpu J", "ane J", "mean W", "p95 W", "max W")
+	for _, p := range phases {
+		s := sessionHistory.summarize(p.from, p.to)
+		fmt.Fprintf(out, "%-24s %10s %7d %9.1f %9.1f %9.1f %9.1f %7.2f %7.2f %7.2f\n",
+			p.name,
+			p.to.Sub(p.from).Round(time.Millisecond),
+			s.Samples,
+			s.EnergyJ[metricPackageW],
+			s.EnergyJ[metricCPUW],
+			s.EnergyJ[metricGPUW],
+			s.EnergyJ[metricANEW],
+			s.MeanW,
+			s.P95W,
+			s.MaxW,
+		)
+	}
+}
+
+// runMarkerClient implements `mactop mark <label>` and `mactop marks [from to]`.
+func runMarkerClient(command string, args []string) int {
+	var request string
+	switch command {
+	case "mark":
+		// The request is one line, so a label cannot span lines.
+		label := strings.TrimSpace(strings.NewReplacer("\r", " ", "\n", " ").Replace(strings.Join(args, " ")))
+		if label == "" {
+			fmt.Println("Usage: mactop mark <label>")
+			return 1
+		}
+		request = "mark " + label
+	case "marks":
+		if len(args) != 0 && len(args) != 2 {
+			fmt.Println("Usage: mactop marks [<from-label> <to-label>]")
+			return 1
+		}
+		request = "summary"
+		for _, label := range args {
+			request += " " + strconv.Quote(label)
+		}
+	}
+	conn, err := net.DialTimeout("unix", markerSocketPath, 2*time.Second)
+	if err != nil {
+		fmt.Println("Error: could not reach a running mactop session:", err)
+		return 1
+	}
+	defer conn.Close()
+	if _, err := fmt.Fprintln(conn, request); err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	reply, err := io.ReadAll(conn)
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	fmt.Print(string(reply))
+	if strings.HasPrefix(string(reply), "error:") {
+		return 1
+	}
+	return 0
+}
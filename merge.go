@@ -0,0 +1,129 @@
+package main
+
+import (
+	"sync"
+	"time"
+)
+
+// Sources that are sampled independently of the powermetrics stream.
+type sourceID int
+
+const (
+	sourcePowermetrics sourceID = iota
+	sourceMemory
+	numSources
+)
+
+var sourceNames = [numSources]string{"powermetrics", "memory"}
+
+type timedMemory struct {
+	at time.Time
+	m  MemoryMetrics
+}
+
+// merger keeps the recent readings of each asynchronous source so samples
+// can be aligned to their own timestamps. A powermetrics sample is aligned
+// when it completes, up to an interval after its timestamp, so the ring
+// must reach back that far. Producers only hold the lock long enough to
+// store a value, so a slow source never blocks the others.
+type merger struct {
+	mu         sync.Mutex
+	memory     []timedMemory // ring, oldest first from head
+	head, n    int
+	staleAfter [numSources]time.Duration
+}
+
+var sessionMerger merger
+
+// keepMemory sizes the memory ring to cover a powermetrics interval of
+// intervalMs with readings every memoryMs, plus one on each side.
+func (m *merger) keepMemory(intervalMs, memoryMs int) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.memory = make([]timedMemory, intervalMs/memoryMs+2)
+	m.head, m.n = 0, 0
+}
+
+func (m *merger) publishMemory(at time.Time, mm MemoryMetrics) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.memory == nil {
+		m.memory = make([]timedMemory, 2)
+	}
+	m.memory[(m.head+m.n)%len(m.memory)] = timedMemory{at, mm}
+	if m.n < len(m.memory) {
+		m.n++
+	} else {
+		m.head = (m.head + 1) % len(m.memory)
+	}
+}
+
+// alignMemory returns memory usage at tick, interpolated between the two
+// readings around it, together with the distance to the nearest reading.
+func (m *merger) alignMemory(tick time.Time) (MemoryMetrics, time.Duration, bool) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.n == 0 {
+		return MemoryMetrics{}, 0, true
+	}
+	// prev is the last reading at or before tick, next the first after it.
+	var prev, next timedMemory
+	for i := 0; i < m.n; i++ {
+		r := m.memory[(m.head+i)%len(m.memory)]
+		if r.at.After(tick) {
+			next = r
+			break
+		}
+		prev = r
+	}
+	var (
+		mm  MemoryMetrics
+		age time.Duration
+	)
+	switch {
+	case next.at.IsZero():
+		mm, age = prev.m, tick.Sub(prev.at)
+	case prev.at.IsZero():
+		mm, age = next.m, next.at.Sub(tick)
+	default:
+		f := float64(tick.Sub(prev.at)) / float64(next.at.Sub(prev.at))
+		mm = MemoryMetrics{
+			Total:     next.m.Total,
+			Used:      lerpUint(prev.m.Used, next.m.Used, f),
+			Available: lerpUint(prev.m.Available, next.m.Available, f),
+			SwapTotal: next.m.SwapTotal,
+			SwapUsed:  lerpUint(prev.m.SwapUsed, next.m.SwapUsed, f),
+		}
+		age = tick.Sub(prev.at)
+		if d := next.at.Sub(tick); d < age {
+			age = d
+		}
+	}
+	limit := m.staleAfter[sourceMemory]
+	return mm, age, limit > 0 && age > limit
+}
+
+func lerpUint(a, b uint64, f float64) uint64 {
+	return uint64(float64(a) + (float64(b)-float64(a))*f)
+}
+
+// align fills the memory fields of a powermetrics sample, aligned to the
+// sample's own timestamp.
+func (m *merger) align(s *sample) {
+	mm, _, _ := m.alignMemory(s.Time)
+	s.Values[metricMemUsed] = float64(mm.Used)
+	s.Values[metricSwapUsed] = float64(mm.SwapUsed)
+}
+
+// sampleMemoryLoop reads memory usage whenever the scheduler asks for it.
+// Requests are dropped rather than queued while a read is in progress.
+func sampleMemoryLoop(done <-chan struct{}, request <-chan struct{}) {
+	for {
+		select {
+		case <-done:
+			return
+		case <-request:
+			sessionMerger.publishMemory(sessionClock.Now(), getMemoryMetrics())
+		}
+	}
+}
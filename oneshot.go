@@ -0,0 +1,122 @@
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"os"
+	"os/exec"
+	"strconv"
+	"time"
+)
+
+type snapshotProcess struct {
+	PID          int     `json:"pid"`
+	Name         string  `json:"name"`
+	CPUMsPerS    float64 `json:"cpu_ms_per_s"`
+	GPUMsPerS    float64 `json:"gpu_ms_per_s"`
+	EnergyImpact float64 `json:"energy_impact"`
+}
+
+type snapshotResult struct {
+	Time      time.Time          `json:"time"`
+	Model     string             `json:"model"`
+	ElapsedS  float64            `json:"elapsed_s"`
+	Metrics   map[string]float64 `json:"metrics"`
+	Processes []snapshotProcess  `json:"processes,omitempty"`
+}
+
+// runSnapshot implements `mactop snapshot`: one short powermetrics sample,
+// printed without the terminal UI. The chip name comes from the hardware
+// cache when there is one, so nothing but powermetrics and at most one
+// sysctl runs.
+func runSnapshot(args []string) int {
+	interval, topN := 200, 10
+	asJSON := false
+	for i := 0; i < len(args); i++ {
+		var err error
+		switch {
+		case args[i] == "--json":
+			asJSON = true
+		case args[i] == "--interval" && i+1 < len(args):
+			interval, err = strconv.Atoi(args[i+1])
+			i++
+		case args[i] == "--processes" && i+1 < len(args):
+			topN, err = strconv.Atoi(args[i+1])
+			i++
+		default:
+			fmt.Println("Usage: mactop snapshot [--json] [--interval 200] [--processes 10]")
+			return 1
+		}
+		if err != nil || interval <= 0 || topN < 0 {
+			fmt.Printf("Error: invalid %s %q\n", args[i-1], args[i])
+			return 1
+		}
+	}
+	if os.Geteuid() != 0 {
+		fmt.Println("Error: mactop snapshot needs sudo, as powermetrics requires root privileges.")
+		return 1
+	}
+
+	model := ""
+	if hw, ok := readHardwareCache(); ok {
+		model = hw.Name
+	} else {
+		model = getCPUInfo()["machdep.cpu.brand_string"]
+	}
+	policy := collectionPolicy{interval: interval, perProcess: topN > 0}
+	out, err := exec.Command("powermetrics", append(policy.args(), "-n", "1")...).Output()
+	if err != nil {
+		fmt.Println("Error: powermetrics:", err)
+		return 1
+	}
+	parser := newSampleParser(newSamplePool(1, 16, 512), model, interval)
+	scanner := bufio.NewScanner(bytes.NewReader(out))
+	var s *sample
+	for scanner.Scan() {
+		if complete := parser.line(lineString(scanner.Bytes())); complete != nil {
+			s = complete // -n 1 prints one sample; keep the last if it printed more
+		}
+	}
+	if last := parser.finish(); last != nil {
+		s = last
+	}
+	if s == nil {
+		fmt.Println("Error: powermetrics printed no sample")
+		return 1
+	}
+	memory := getMemoryMetrics()
+	s.Values[metricMemUsed] = float64(memory.Used)
+	s.Values[metricSwapUsed] = float64(memory.SwapUsed)
+
+	res := snapshotResult{Time: s.Time, Model: model, ElapsedS: s.Elapsed, Metrics: make(map[string]float64, numMetrics)}
+	for i, name := range metricNames {
+		res.Metrics[name] = s.Values[i]
+	}
+	procs := s.Processes
+	if len(procs) > topN {
+		procs = procs[:topN]
+	}
+	for _, pm := range procs {
+		res.Processes = append(res.Processes, snapshotProcess{pm.ID, pm.Name, pm.CPUUsage, pm.GPUUsage, pm.EnergyImpact})
+	}
+
+	if asJSON {
+		enc := json.NewEncoder(os.Stdout)
+		enc.SetIndent("", "  ")
+		if err := enc.Encode(res); err != nil {
+			fmt.Println("Error:", err)
+			return 1
+		}
+		return 0
+	}
+	fmt.Printf("%s, %.0f ms sample at %s\n", res.Model, res.ElapsedS*1000, res.Time.Format(time.RFC3339))
+	for i, name := range metricNames {
+		fmt.Printf("%-16s %g\n", name, s.Values[i])
+	}
+	for _, p := range res.Processes {
+		fmt.Printf("%6d %-24s %8.1f ms/s CPU %8.1f ms/s GPU %8.1f energy\n", p.PID, p.Name, p.CPUMsPerS, p.GPUMsPerS, p.EnergyImpact)
+	}
+	return 0
+}
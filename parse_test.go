@@ -0,0 +1,156 @@
+package main
+
+import (
+	"strings"
+	"testing"
+)
+
+const testSample = `*** Sampled system activity (Wed Oct 18 10:00:00 2023 +0200) (1003.21ms elapsed) ***
+
+*** Running tasks ***
+
+Name                                ID     CPU ms/s  User%  Deadlines (<2 ms, 2-5 ms)  Wakeups (Intr, Pkg idle)  GPU ms/s  Energy Impact
+WindowServer                        153    85.40     46.12  0.00         0.00          120.33       10.08        12.50     40.21
+Google Chrome Helper (GPU)          2211   40.10     55.00  0.00         0.00          30.00        2.00         3.25      18.40
+kernel_task                         0      20.02     0.00   0.00         0.00          500.10       80.77        0.00      9.80
+ALL_TASKS                           -2     145.52    50.00  0.00         0.00          0.00         0.00
+
+**** Network activity ****
+
+out: 12.00 packets/s, 3400.50 bytes/s
+in:  20.00 packets/s, 9100.25 bytes/s
+
+**** Disk activity ****
+
+read: 3.00 ops/s 48.00 KBytes/s
+write: 7.50 ops/s 120.00 KBytes/s
+
+**** Processor usage ****
+
+E-Cluster HW active frequency: 1020 MHz
+E-Cluster HW active residency:  35.20% (600 MHz:  64% 2064 MHz:  35%)
+E-Cluster idle residency:  64.80%
+CPU 0 frequency: 1100 MHz
+CPU 0 active residency:  40.00% (600 MHz:  60% 2064 MHz:  40%)
+CPU 1 frequency: 980 MHz
+CPU 1 active residency:  30.40% (600 MHz:  70% 2064 MHz:  30%)
+P-Cluster HW active frequency: 2800 MHz
+P-Cluster HW active residency:  61.50% (660 MHz:  38% 3504 MHz:  61%)
+P-Cluster idle residency:  38.50%
+CPU 4 frequency: 2800 MHz
+CPU 4 active residency:  61.50% (660 MHz:  38% 3504 MHz:  61%)
+
+CPU Power: 2450 mW
+GPU Power: 310 mW
+ANE Power: 0 mW
+Combined Power (CPU + GPU + ANE): 2760 mW
+
+**** GPU usage ****
+
+GPU HW active frequency: 444 MHz
+GPU HW active residency:  12.30% (389 MHz:   0% 486 MHz:  12% 648 MHz:   0%)
+GPU idle residency:  87.70%
+GPU Power: 310 mW
+
+**** Thermal pressure ****
+
+Current pressure level: Moderate
+`
+
+// feedSamples runs n copies of testSample through p and returns the last
+// completed sample, still referenced.
+func feedSamples(p *sampleParser, lines []string, n int) *sample {
+	var last *sample
+	for i := 0; i < n; i++ {
+		for _, line := range lines {
+			if s := p.line(line); s != nil {
+				if last != nil {
+					last.release()
+				}
+				last = s
+			}
+		}
+	}
+	return last
+}
+
+func TestParseSample(t *testing.T) {
+	lines := strings.Split(testSample, "\n")
+	p := newSampleParser(newSamplePool(2, 16, 64), "Apple M2", 1000)
+	// The thermal pressure line completes the sample; no header follows.
+	s := feedSamples(p, lines, 1)
+	if s == nil {
+		t.Fatal("no sample")
+	}
+	if p.finish() != nil {
+		t.Error("sample still open after the pressure line")
+	}
+	if s.Elapsed != 1.00321 {
+		t.Errorf("elapsed %v", s.Elapsed)
+	}
+	if len(s.Processes) != 3 || s.Processes[0].Name != "WindowServer" || s.Processes[1].Name != "Google Chrome Helper (GPU)" {
+		t.Fatalf("processes %+v", s.Processes)
+	}
+	chrome := s.Processes[1]
+	if chrome.ID != 2211 || chrome.CPUUsage != 40.10 || chrome.GPUUsage != 3.25 || chrome.EnergyImpact != 18.40 {
+		t.Errorf("process %+v", chrome)
+	}
+	nd := s.NetDisk
+	if nd.OutPacketsPerSec != 12 || nd.OutBytesPerSec != 3400.50 || nd.InBytesPerSec != 9100.25 || nd.ReadKBytesPerSec != 48 || nd.WriteOpsPerSec != 7.5 {
+		t.Errorf("net/disk %+v", nd)
+	}
+	cpu := s.CPU
+	if cpu.EClusterActive != 35 || cpu.EClusterFreqMHz != 1020 || cpu.PClusterActive != 61 || cpu.PClusterFreqMHz != 2800 {
+		t.Errorf("clusters %+v", cpu)
+	}
+	if len(cpu.ECores) != 0 || cpu.CPUW != 2.45 || cpu.GPUW != 0.31 || cpu.PackageW != 2.76 {
+		t.Errorf("cpu %+v", cpu)
+	}
+	if s.GPU.Active != 12.30 || s.GPU.FreqMHz != 486 {
+		t.Errorf("gpu %+v", s.GPU)
+	}
+	if s.Values[metricThermalPressure] != 1 {
+		t.Errorf("thermal pressure %v", s.Values[metricThermalPressure])
+	}
+}
+
+func TestParseSampleMax(t *testing.T) {
+	lines := strings.Split(testSample, "\n")
+	p := newSampleParser(newSamplePool(2, 16, 64), "Apple M2 Max", 1000)
+	s := feedSamples(p, lines, 1)
+	if s.CPU.CPUW != 2.45 || s.CPU.EClusterActive == 0 || s.CPU.PClusterActive == 0 {
+		t.Errorf("cpu %+v", s.CPU)
+	}
+}
+
+// A steady stream of samples must not allocate once the sample pool and
+// the process name table are warm.
+func TestParseSampleAllocs(t *testing.T) {
+	lines := strings.Split(testSample, "\n")
+	for _, model := range []string{"Apple M2", "Apple M3 Max"} {
+		p := newSampleParser(newSamplePool(4, 16, 64), model, 1000)
+		if last := feedSamples(p, lines, 3); last != nil {
+			last.release()
+		}
+		allocs := testing.AllocsPerRun(100, func() {
+			if last := feedSamples(p, lines, 1); last != nil {
+				last.release()
+			}
+		})
+		if allocs != 0 {
+			t.Errorf("%s: %v allocations per sample", model, allocs)
+		}
+	}
+}
+
+func BenchmarkParseSample(b *testing.B) {
+	lines := strings.Split(testSample, "\n")
+	p := newSampleParser(newSamplePool(4, 16, 64), "Apple M2", 1000)
+	b.ReportAllocs()
+	b.SetBytes(int64(len(testSample)))
+	for i := 0; i < b.N; i++ {
+		if last := feedSamples(p, lines, 1); last != nil {
+			last.release()
+		}
+	}
+}
@@ -0,0 +1,189 @@
+package main
+
+import (
+	"bufio"
+	"encoding/json"
+	"math"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+// fakePowermetrics builds cmd/fake-powermetrics as powermetrics, with
+// sysctl linked to it, puts it first on PATH and has it replay testSample.
+func fakePowermetrics(t *testing.T) {
+	t.Helper()
+	goTool, err := exec.LookPath("go")
+	if err != nil {
+		t.Skip("go tool not on PATH")
+	}
+	dir := t.TempDir()
+	bin := filepath.Join(dir, "powermetrics")
+	if out, err := exec.Command(goTool, "build", "-o", bin, "./cmd/fake-powermetrics").CombinedOutput(); err != nil {
+		t.Fatalf("building fake powermetrics: %v\n%s", err, out)
+	}
+	if err := os.Symlink(bin, filepath.Join(dir, "sysctl")); err != nil {
+		t.Fatal(err)
+	}
+	fixture := filepath.Join(dir, "fixture.txt")
+	if err := os.WriteFile(fixture, []byte(testSample), 0644); err != nil {
+		t.Fatal(err)
+	}
+	t.Setenv("PATH", dir+string(os.PathListSeparator)+os.Getenv("PATH"))
+	t.Setenv("FAKE_POWERMETRICS_FIXTURE", fixture)
+	t.Setenv("FAKE_POWERMETRICS_SPEED", "10")
+}
+
+// checkFixtureSample reports how a sample parsed from testSample, replayed
+// at a 100 ms interval, differs from it; "" when it matches.
+func checkFixtureSample(s *sample) string {
+	switch {
+	case math.Abs(s.Elapsed-0.1) > 0.001:
+		return "elapsed"
+	case len(s.Processes) != 3 || s.Processes[0].Name != "WindowServer" || s.Processes[1].ID != 2211 || s.Processes[2].Name != "kernel_task":
+		return "processes"
+	case s.NetDisk.InBytesPerSec != 9100.25 || s.NetDisk.WriteOpsPerSec != 7.5:
+		return "net/disk"
+	case s.CPU.PClusterFreqMHz != 2800 || s.CPU.PackageW != 2.76 || s.Values[metricPackageW] != 2.76:
+		return "cpu"
+	case s.GPU.FreqMHz != 486 || s.Values[metricThermalPressure] != 1:
+		return "gpu/thermal"
+	}
+	return ""
+}
+
+// collectFake runs runPowermetrics against the fake until n samples have
+// been checked, then stops it.
+func collectFake(t *testing.T, n int) {
+	t.Helper()
+	done := make(chan struct{})
+	samples := make(chan *sample)
+	stopped := make(chan bool)
+	go func() {
+		_, restart := runPowermetrics(done, samples, newSamplePool(4, 16, 64), "Apple M2", collectionPolicy{interval: 100, perProcess: true})
+		stopped <- restart
+	}()
+	for i := 0; i < n; i++ {
+		s := <-samples
+		if diff := checkFixtureSample(s); diff != "" {
+			t.Errorf("sample %d: wrong %s: %+v", i, diff, s)
+		}
+		s.release()
+	}
+	close(done)
+	for {
+		select {
+		case s := <-samples:
+			s.release()
+		case restart := <-stopped:
+			if restart {
+				t.Error("runPowermetrics asked for a restart")
+			}
+			return
+		}
+	}
+}
+
+func TestFakePowermetrics(t *testing.T) {
+	fakePowermetrics(t)
+	t.Run("stream", func(t *testing.T) {
+		collectFake(t, 5)
+	})
+	t.Run("partial", func(t *testing.T) {
+		t.Setenv("FAKE_POWERMETRICS_PARTIAL", "1")
+		collectFake(t, 5)
+	})
+	t.Run("snapshot", func(t *testing.T) {
+		if os.Geteuid() != 0 {
+			t.Skip("snapshot needs root")
+		}
+		out := captureStdout(t, func() {
+			if status := runSnapshot([]string{"--json", "--interval", "100", "--processes", "2"}); status != 0 {
+				t.Errorf("status %d", status)
+			}
+		})
+		var res snapshotResult
+		if err := json.Unmarshal([]byte(out), &res); err != nil {
+			t.Fatalf("%v: %s", err, out)
+		}
+		if res.Metrics["PackageW"] != 2.76 || res.Metrics["GPUFreqMHz"] != 486 || len(res.Processes) != 2 || res.Processes[1].Name != "Google Chrome Helper (GPU)" {
+			t.Errorf("snapshot %+v", res)
+		}
+	})
+	t.Run("snapshot crash", func(t *testing.T) {
+		if os.Geteuid() != 0 {
+			t.Skip("snapshot needs root")
+		}
+		t.Setenv("FAKE_POWERMETRICS_CRASH", "1")
+		out := captureStdout(t, func() {
+			if status := runSnapshot([]string{"--interval", "100"}); status != 1 {
+				t.Errorf("status %d", status)
+			}
+		})
+		if !strings.HasPrefix(out, "Error: powermetrics:") {
+			t.Errorf("output %q", out)
+		}
+	})
+}
+
+// A crash ends the session; every sample published before it must be
+// whole. runPowermetrics exits the process then, so it runs in a child.
+func TestFakePowermetricsCrash(t *testing.T) {
+	if os.Getenv("MACTOP_TEST_CRASH_CHILD") != "" {
+		done := make(chan struct{})
+		samples := make(chan *sample)
+		go runPowermetrics(done, samples, newSamplePool(4, 16, 64), "Apple M2", collectionPolicy{interval: 100, perProcess: true})
+		for s := range samples {
+			if diff := checkFixtureSample(s); diff != "" {
+				os.Stdout.WriteString("bad " + diff + "\n")
+			} else {
+				os.Stdout.WriteString("ok\n")
+			}
+			s.release()
+		}
+	}
+	fakePowermetrics(t)
+	cmd := exec.Command(os.Args[0], "-test.run=^TestFakePowermetricsCrash$")
+	cmd.Env = append(os.Environ(), "MACTOP_TEST_CRASH_CHILD=1", "FAKE_POWERMETRICS_CRASH=0.2", "FAKE_POWERMETRICS_SEED=3")
+	out, err := cmd.Output()
+	if exit, ok := err.(*exec.ExitError); !ok || exit.ExitCode() != 1 {
+		t.Fatalf("child ended with %v, want exit status 1\n%s", err, out)
+	}
+	ok := 0
+	for sc := bufio.NewScanner(strings.NewReader(string(out))); sc.Scan(); {
+		switch line := sc.Text(); {
+		case line == "ok":
+			ok++
+		case strings.HasPrefix(line, "bad"):
+			t.Error(line)
+		}
+	}
+	if ok == 0 {
+		t.Errorf("no samples before the crash:\n%s", out)
+	}
+}
+
+func captureStdout(t *testing.T, f func()) string {
+	t.Helper()
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatal(err)
+	}
+	stdout := os.Stdout
+	os.Stdout = w
+	read := make(chan string)
+	go func() {
+		var sb strings.Builder
+		sc := bufio.NewScanner(r)
+		for sc.Scan() {
+			sb.WriteString(sc.Text() + "\n")
+		}
+		read <- sb.String()
+	}()
+	f()
+	os.Stdout = stdout
+	w.Close()
+	return <-read
+}
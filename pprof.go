@@ -0,0 +1,334 @@
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"compress/gzip"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// energyProfile accumulates CPU time, GPU time and estimated energy per
+// process for --pprof, written on exit as a pprof profile whose stacks are
+// the process tree, so `go tool pprof` shows a flame graph of where a
+// build's energy went. Energy is CPU and GPU rail energy split between
+// processes by their share of CPU and GPU time in each sample.
+//
+// powermetrics does not report parent PIDs; they come from ps, run off the
+// UI goroutine every processTreeInterval and as soon as a new process
+// shows up. A process that exits before ps sees it, or whose pid has
+// already been reused, has no known ancestry and sits directly under the
+// root.
+const (
+	processTreeInterval = 5 * time.Second
+	profileMaxProcesses = 1 << 16
+	profileMaxDepth     = 64
+)
+
+var (
+	pprofPath      string
+	sessionProfile *energyProfile
+)
+
+type profileEntry struct {
+	cpuMs, gpuMs, energyMJ float64
+	stack                  []string // ancestor names, parent first
+	resolved               bool
+}
+
+type energyProfile struct {
+	mu          sync.Mutex
+	start       time.Time
+	procs       map[procKey]*profileEntry
+	other       profileEntry  // processes beyond profileMaxProcesses
+	treeRequest chan struct{} // asks sampleProcessTreeLoop for a ps run
+}
+
+func newEnergyProfile() *energyProfile {
+	return &energyProfile{start: sessionClock.Now(), procs: make(map[procKey]*profileEntry), treeRequest: make(chan struct{}, 1)}
+}
+
+// requestTree asks for a process tree read unless one is already pending.
+func (p *energyProfile) requestTree() {
+	select {
+	case p.treeRequest <- struct{}{}:
+	default:
+	}
+}
+
+func (p *energyProfile) observe(s *sample) {
+	var cpuTotal, gpuTotal float64
+	for i := range s.Processes {
+		cpuTotal += s.Processes[i].CPUUsage
+		gpuTotal += s.Processes[i].GPUUsage
+	}
+	cpuMJ := s.Values[metricCPUW] * s.Elapsed * 1000
+	gpuMJ := s.Values[metricGPUW] * s.Elapsed * 1000
+	added := false
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	for i := range s.Processes {
+		pm := &s.Processes[i]
+		k := procKey{pm.ID, pm.Name}
+		e := p.procs[k]
+		if e == nil {
+			if len(p.procs) >= profileMaxProcesses {
+				e = &p.other
+			} else {
+				e = &profileEntry{}
+				p.procs[k] = e
+				added = true
+			}
+		}
+		e.cpuMs += pm.CPUUsage * s.Elapsed
+		e.gpuMs += pm.GPUUsage * s.Elapsed
+		if cpuTotal > 0 {
+			e.energyMJ += cpuMJ * pm.CPUUsage / cpuTotal
+		}
+		if gpuTotal > 0 {
+			e.energyMJ += gpuMJ * pm.GPUUsage / gpuTotal
+		}
+	}
+	if added {
+		// Short-lived processes are gone by the next periodic read.
+		p.requestTree()
+	}
+}
+
+type psEntry struct {
+	ppid int
+	name string
+}
+
+// readProcessTree lists every process's parent and command name.
+func readProcessTree() (map[int]psEntry, error) {
+	out, err := exec.Command("ps", "-axo", "pid=,ppid=,comm=").Output()
+	if err != nil {
+		return nil, err
+	}
+	return parseProcessTree(out), nil
+}
+
+func parseProcessTree(out []byte) map[int]psEntry {
+	tree := make(map[int]psEntry)
+	scanner := bufio.NewScanner(bytes.NewReader(out))
+	for scanner.Scan() {
+		fields := strings.Fields(scanner.Text())
+		if len(fields) < 3 {
+			continue
+		}
+		pid, err1 := strconv.Atoi(fields[0])
+		ppid, err2 := strconv.Atoi(fields[1])
+		if err1 != nil || err2 != nil {
+			continue
+		}
+		tree[pid] = psEntry{ppid, filepath.Base(strings.Join(fields[2:], " "))}
+	}
+	return tree
+}
+
+// resolve records the ancestry of every process that does not have it yet
+// and is still running. A pid that now runs under another name was reused
+// after the process exited; its ancestry is lost, not borrowed.
+func (p *energyProfile) resolve(tree map[int]psEntry) {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	for k, e := range p.procs {
+		if e.resolved {
+			continue
+		}
+		self, ok := tree[k.pid]
+		if !ok {
+			continue
+		}
+		e.resolved = true
+		if !sameProcessName(self.name, k.name) {
+			continue
+		}
+		for pid := self.ppid; pid > 0 && len(e.stack) < profileMaxDepth; {
+			parent, ok := tree[pid]
+			if !ok {
+				break
+			}
+			e.stack = append(e.stack, parent.name)
+			pid = parent.ppid
+		}
+	}
+}
+
+// sameProcessName compares a name from ps with one from powermetrics,
+// either of which may be cut to the kernel's 15-character p_comm.
+func sameProcessName(a, b string) bool {
+	if len(a) > len(b) {
+		a, b = b, a
+	}
+	return a == b || (len(a) >= 15 && strings.HasPrefix(b, a))
+}
+
+func sampleProcessTreeLoop(done chan struct{}, request chan struct{}) {
+	for {
+		select {
+		case <-done:
+			return
+		case <-request:
+			tree, err := readProcessTree()
+			if err != nil {
+				stderrLogger.Printf("process tree unavailable: %v", err)
+				continue
+			}
+			sessionProfile.resolve(tree)
+		}
+	}
+}
+
+// write encodes the profile as gzipped profile.proto. Each process is one
+// sample, labelled with its pid, whose stack runs from the process up to
+// its oldest known ancestor.
+func (p *energyProfile) write(path string, end time.Time) error {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	keys := make([]procKey, 0, len(p.procs))
+	for k := range p.procs {
+		keys = append(keys, k)
+	}
+	sort.Slice(keys, func(i, j int) bool { return keys[i].pid < keys[j].pid })
+
+	strs := map[string]int{"": 0}
+	table := []string{""}
+	str := func(s string) int {
+		i, ok := strs[s]
+		if !ok {
+			i = len(table)
+			strs[s] = i
+			table = append(table, s)
+		}
+		return i
+	}
+	funcs := map[string]uint64{} // one function and location per name
+	var funcNames []string
+	loc := func(name string) uint64 {
+		id, ok := funcs[name]
+		if !ok {
+			id = uint64(len(funcNames) + 1)
+			funcs[name] = id
+			funcNames = append(funcNames, name)
+		}
+		return id
+	}
+
+	var pb protoBuffer
+	for _, vt := range [][2]string{{"cpu_ms", "milliseconds"}, {"gpu_ms", "milliseconds"}, {"energy_mj", "millijoules"}} {
+		pb.message(1, func(m *protoBuffer) { // sample_type
+			m.int64Field(1, int64(str(vt[0])))
+			m.int64Field(2, int64(str(vt[1])))
+		})
+	}
+	addSample := func(pid int, name string, e *profileEntry) {
+		locs := []uint64{loc(name)}
+		for _, a := range e.stack {
+			locs = append(locs, loc(a))
+		}
+		pb.message(2, func(m *protoBuffer) {
+			m.packed(1, locs)
+			m.packed(2, []uint64{uint64(int64(e.cpuMs + 0.5)), uint64(int64(e.gpuMs + 0.5)), uint64(int64(e.energyMJ + 0.5))})
+			if pid > 0 {
+				m.message(3, func(l *protoBuffer) {
+					l.int64Field(1, int64(str("pid")))
+					l.int64Field(3, int64(pid))
+				})
+			}
+		})
+	}
+	for _, k := range keys {
+		addSample(k.pid, k.name, p.procs[k])
+	}
+	if p.other.cpuMs+p.other.gpuMs+p.other.energyMJ > 0 {
+		addSample(0, "(other processes)", &p.other)
+	}
+	for i, name := range funcNames {
+		id := uint64(i + 1)
+		pb.message(4, func(m *protoBuffer) { // location
+			m.int64Field(1, int64(id))
+			m.message(4, func(l *protoBuffer) { l.int64Field(1, int64(id)) })
+		})
+		pb.message(5, func(m *protoBuffer) { // function
+			m.int64Field(1, int64(id))
+			m.int64Field(2, int64(str(name)))
+			m.int64Field(3, int64(str(name)))
+		})
+	}
+	defaultType := int64(str("energy_mj"))
+	for _, s := range table {
+		pb.stringField(6, s)
+	}
+	pb.int64Field(9, p.start.UnixNano())
+	pb.int64Field(10, int64(end.Sub(p.start)))
+	pb.int64Field(14, defaultType)
+
+	f, err := os.Create(path)
+	if err != nil {
+		return err
+	}
+	zw := gzip.NewWriter(f)
+	if _, err := zw.Write(pb.b); err != nil {
+		f.Close()
+		return err
+	}
+	if err := zw.Close(); err != nil {
+		f.Close()
+		return err
+	}
+	return f.Close()
+}
+
+// protoBuffer encodes the few protobuf wire types profile.proto needs.
+type protoBuffer struct {
+	b []byte
+}
+
+func (p *protoBuffer) varint(x uint64) {
+	for x >= 0x80 {
+		p.b = append(p.b, byte(x)|0x80)
+		x >>= 7
+	}
+	p.b = append(p.b, byte(x))
+}
+
+func (p *protoBuffer) int64Field(field int, x int64) {
+	if x == 0 {
+		return
+	}
+	p.varint(uint64(field) << 3)
+	p.varint(uint64(x))
+}
+
+func (p *protoBuffer) bytesField(field int, b []byte) {
+	p.varint(uint64(field)<<3 | 2)
+	p.varint(uint64(len(b)))
+	p.b = append(p.b, b...)
+}
+
+// stringField writes s even when empty: the string table must start with "".
+func (p *protoBuffer) stringField(field int, s string) {
+	p.bytesField(field, []byte(s))
+}
+
+func (p *protoBuffer) packed(field int, xs []uint64) {
+	var inner protoBuffer
+	for _, x := range xs {
+		inner.varint(x)
+	}
+	p.bytesField(field, inner.b)
+}
+
+func (p *protoBuffer) message(field int, fill func(*protoBuffer)) {
+	var inner protoBuffer
+	fill(&inner)
+	p.bytesField(field, inner.b)
+}
@@ -0,0 +1,411 @@
+package main
+
+import (
+	"encoding/csv"
+	"encoding/json"
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"sort"
+	"strconv"
+	"strings"
+	"time"
+)
+
+const queryMaxSteps = 1 << 20
+
+var tierNames = map[uint8]string{blockRaw: "raw", blockRollup1m: "1m", blockRollup1h: "1h"}
+
+// queryCell aggregates one metric over one step.
+type queryCell struct {
+	n, sum, wsum, min, max float64
+	values                 []float64 // only kept for percentiles
+}
+
+func (c *queryCell) add(n, sum, wsum, min, max float64, keep bool) {
+	if c.n == 0 || min < c.min {
+		c.min = min
+	}
+	if c.n == 0 || max > c.max {
+		c.max = max
+	}
+	c.n += n
+	c.sum += sum
+	c.wsum += wsum
+	if keep {
+		c.values = append(c.values, sum/n)
+	}
+}
+
+// addRun adds a run of raw samples with the seconds each covered.
+func (c *queryCell) addRun(values, elapsed []float64, keep bool) {
+	a := reduceFloat64(values)
+	c.add(float64(a.n), a.sum, dotFloat64(values, elapsed), a.min, a.max, false)
+	if keep {
+		c.values = append(c.values, values...)
+	}
+}
+
+func (c *queryCell) result(agg string) float64 {
+	switch agg {
+	case "min":
+		return c.min
+	case "max":
+		return c.max
+	case "sum":
+		return c.sum
+	case "count":
+		return c.n
+	case "energy":
+		return c.wsum
+	case "mean":
+		return c.sum / c.n
+	}
+	p, _ := strconv.ParseFloat(agg[1:], 64)
+	sort.Float64s(c.values)
+	return percentileSorted(c.values, p)
+}
+
+func validAgg(agg string) bool {
+	switch agg {
+	case "min", "max", "sum", "count", "energy", "mean":
+		return true
+	}
+	if p, err := strconv.ParseFloat(strings.TrimPrefix(agg, "p"), 64); err == nil && agg[0] == 'p' {
+		return p > 0 && p <= 100
+	}
+	return false
+}
+
+// parseQueryTime accepts RFC 3339, "2006-01-02 15:04:05" local time, unix
+// seconds, "now", or a negative duration relative to now such as -2h.
+func parseQueryTime(s string, now time.Time) (time.Time, error) {
+	if s == "now" {
+		return now, nil
+	}
+	if strings.HasPrefix(s, "-") {
+		d, err := time.ParseDuration(s)
+		if err == nil {
+			return now.Add(d), nil
+		}
+	}
+	if secs, err := strconv.ParseFloat(s, 64); err == nil {
+		return time.Unix(0, int64(secs*1e9)), nil
+	}
+	if t, err := time.Parse(time.RFC3339Nano, s); err == nil {
+		return t, nil
+	}
+	return time.ParseInLocation("2006-01-02 15:04:05", s, time.Local)
+}
+
+// queryTier picks the coarsest tier whose bucket width divides the step.
+// Percentiles need individual samples and always read raw data.
+func queryTier(step time.Duration, agg string) uint8 {
+	if agg[0] == 'p' || step == 0 {
+		return blockRaw
+	}
+	for _, kind := range []uint8{blockRollup1h, blockRollup1m} {
+		if step%rollupWidths[kind] == 0 {
+			return kind
+		}
+	}
+	return blockRaw
+}
+
+type queryResult struct {
+	Agg     string              `json:"agg"`
+	Tier    string              `json:"tier"`
+	StepS   float64             `json:"step_s"`
+	Metrics []string            `json:"metrics"`
+	Rows    []queryResultRow    `json:"rows"`
+	cells   map[int][]queryCell // by step
+}
+
+type queryResultRow struct {
+	Time   time.Time `json:"time"`
+	Values []float64 `json:"values"`
+}
+
+// runQuery implements `mactop query <recording> --metric a,b ...`.
+func runQuery(args []string) int {
+	usage := func() int {
+		fmt.Println("Usage: mactop query <recording> --metric <name[,name...]> [--from T] [--to T] [--step D] [--agg A] [--format csv|json]")
+		fmt.Println("T is RFC 3339, unix seconds, 'now' or a relative duration such as -2h.")
+		fmt.Println("A is mean (default), min, max, sum, count, energy (joules for power rails) or a percentile such as p95.")
+		fmt.Println("Metrics:", strings.Join(metricNames[:], ", "))
+		return 1
+	}
+	var dir, fromArg, toArg string
+	var metrics []string
+	var step time.Duration
+	agg, format := "mean", "csv"
+	for i := 0; i < len(args); i++ {
+		flagArg := func() string {
+			if i+1 >= len(args) {
+				return ""
+			}
+			i++
+			return args[i]
+		}
+		var err error
+		switch args[i] {
+		case "--metric", "-m":
+			metrics = strings.Split(flagArg(), ",")
+		case "--from":
+			fromArg = flagArg()
+		case "--to":
+			toArg = flagArg()
+		case "--step":
+			step, err = time.ParseDuration(flagArg())
+		case "--agg":
+			agg = strings.ToLower(flagArg())
+		case "--format":
+			format = strings.ToLower(flagArg())
+		case "--help", "-h":
+			return usage()
+		default:
+			if strings.HasPrefix(args[i], "-") || dir != "" {
+				fmt.Println("Error: unexpected argument", args[i])
+				return usage()
+			}
+			dir = args[i]
+		}
+		if err != nil {
+			fmt.Println("Error:", err)
+			return 1
+		}
+	}
+	if dir == "" || len(metrics) == 0 || metrics[0] == "" || step < 0 || !validAgg(agg) || (format != "csv" && format != "json") {
+		return usage()
+	}
+	for _, name := range metrics {
+		if _, ok := metricByName(name); !ok {
+			fmt.Println("Error: unknown metric", name)
+			return usage()
+		}
+	}
+
+	segs, first, last, err := openRecording(dir)
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	now := time.Now()
+	from, to := time.Unix(0, first), time.Unix(0, last)
+	if fromArg != "" {
+		if from, err = parseQueryTime(fromArg, now); err != nil {
+			fmt.Println("Error: invalid --from:", err)
+			return 1
+		}
+	}
+	if toArg != "" {
+		if to, err = parseQueryTime(toArg, now); err != nil {
+			fmt.Println("Error: invalid --to:", err)
+			return 1
+		}
+	}
+	if !to.After(from) {
+		fmt.Println("Error: --to must be after --from")
+		return 1
+	}
+	if step > 0 && to.Sub(from)/step > queryMaxSteps {
+		fmt.Println("Error: --step is too small for the time range")
+		return 1
+	}
+
+	res, err := queryRecording(segs, metrics, from, to, step, agg)
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	if format == "json" {
+		err = res.writeJSON(os.Stdout)
+	} else {
+		err = res.writeCSV(os.Stdout)
+	}
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	return 0
+}
+
+// queryRecording aggregates the metrics over [from, to] per step, reading
+// only the index-selected blocks of the chosen tier. With a rollup tier the
+// range is widened to whole buckets and the steps are aligned to them, so
+// every step is answered from rollups whatever the start. A segment without
+// that tier in range falls back to raw samples, then to the other rollups:
+// the segment being written has no rollups yet, and retention drops raw
+// samples from old ones. Percentiles cannot fall back to rollups, so such
+// segments are skipped with a warning. The result's Tier names the tiers
+// actually read.
+func queryRecording(segs []*segmentReader, metrics []string, from, to time.Time, step time.Duration, agg string) (*queryResult, error) {
+	tier := queryTier(step, agg)
+	if w, ok := rollupWidths[tier]; ok {
+		from, to = from.Truncate(w), to.Truncate(w).Add(w-1)
+	}
+	lo, hi := from.UnixNano(), to.UnixNano()
+	res := &queryResult{Agg: agg, Tier: tierNames[tier], StepS: step.Seconds(), Metrics: metrics, cells: make(map[int][]queryCell)}
+	keep := agg[0] == 'p'
+	cell := func(t int64, m int) *queryCell {
+		i := 0
+		if step > 0 {
+			i = int((t - lo) / int64(step))
+		}
+		row := res.cells[i]
+		if row == nil {
+			row = make([]queryCell, len(metrics))
+			res.cells[i] = row
+		}
+		return &row[m]
+	}
+
+	read := make(map[uint8]bool)
+	skipped := 0
+	for _, r := range segs {
+		var blocks []indexEntry
+		kind := tier
+		for _, kind = range []uint8{tier, blockRaw, blockRollup1m, blockRollup1h} {
+			if blocks = r.blocks(kind, lo, hi); len(blocks) > 0 {
+				break
+			}
+		}
+		if len(blocks) == 0 {
+			continue
+		}
+		if keep && kind != blockRaw {
+			// Percentiles of bucket means would be silently wrong.
+			fmt.Fprintf(os.Stderr, "Warning: skipping %s: retention dropped its raw samples, which %s needs\n", r.path, agg)
+			skipped++
+			continue
+		}
+		read[kind] = true
+		f, err := os.Open(r.path)
+		if err != nil {
+			return nil, err
+		}
+		for _, e := range blocks {
+			h, payload, err := r.readBlock(f, e)
+			if err != nil {
+				fmt.Fprintf(os.Stderr, "Warning: %s at offset %d: %v\n", r.path, e.Offset, err)
+				continue
+			}
+			if kind == blockRaw {
+				times, elapsed, cols, err := r.decodeRaw(int(h.Count), payload)
+				if err != nil {
+					f.Close()
+					return nil, err
+				}
+				for m, name := range metrics {
+					c := r.metricColumn(name)
+					if c < 0 {
+						continue
+					}
+					// Samples are in time order: reduce each run that
+					// falls into one step at once.
+					for j := 0; j < len(times); {
+						if times[j] < lo || times[j] > hi {
+							j++
+							continue
+						}
+						k := j + 1
+						for k < len(times) && times[k] <= hi && (step == 0 || (times[k]-lo)/int64(step) == (times[j]-lo)/int64(step)) {
+							k++
+						}
+						cell(times[j], m).addRun(cols[c][j:k], elapsed[j:k], keep)
+						j = k
+					}
+				}
+				continue
+			}
+			buckets, err := r.decodeRollups(int(h.Count), payload)
+			if err != nil {
+				f.Close()
+				return nil, err
+			}
+			for m, name := range metrics {
+				id, _ := metricByName(name)
+				for j := range buckets {
+					b := &buckets[j]
+					if b.N == 0 || b.Start < lo || b.Start > hi {
+						continue
+					}
+					cell(b.Start, m).add(float64(b.N), b.Sum[id], b.WSum[id], b.Min[id], b.Max[id], keep)
+				}
+			}
+		}
+		f.Close()
+	}
+	if skipped > 0 && len(read) == 0 {
+		return nil, fmt.Errorf("no raw samples in range for %s; only rollups are left", agg)
+	}
+	if len(read) > 0 {
+		var names []string
+		for _, kind := range []uint8{blockRaw, blockRollup1m, blockRollup1h} {
+			if read[kind] {
+				names = append(names, tierNames[kind])
+			}
+		}
+		res.Tier = strings.Join(names, "+")
+	}
+
+	steps := make([]int, 0, len(res.cells))
+	for i := range res.cells {
+		steps = append(steps, i)
+	}
+	sort.Ints(steps)
+	for _, i := range steps {
+		row := queryResultRow{Time: from.Add(time.Duration(i) * step), Values: make([]float64, len(metrics))}
+		for m := range metrics {
+			c := &res.cells[i][m]
+			if c.n == 0 {
+				row.Values[m] = math.NaN()
+				continue
+			}
+			row.Values[m] = c.result(agg)
+		}
+		res.Rows = append(res.Rows, row)
+	}
+	return res, nil
+}
+
+func (r *queryResult) writeCSV(out io.Writer) error {
+	w := csv.NewWriter(out)
+	w.Write(append([]string{"time"}, r.Metrics...))
+	rec := make([]string, len(r.Metrics)+1)
+	for _, row := range r.Rows {
+		rec[0] = row.Time.Format(time.RFC3339)
+		for i, v := range row.Values {
+			rec[i+1] = ""
+			if !math.IsNaN(v) {
+				rec[i+1] = strconv.FormatFloat(v, 'f', -1, 64)
+			}
+		}
+		w.Write(rec)
+	}
+	w.Flush()
+	return w.Error()
+}
+
+func (r *queryResult) writeJSON(out io.Writer) error {
+	type jsonRow struct {
+		Time   time.Time     `json:"time"`
+		Values []interface{} `json:"values"` // null where a step has no data
+	}
+	rows := make([]jsonRow, len(r.Rows))
+	for i, row := range r.Rows {
+		rows[i] = jsonRow{Time: row.Time, Values: make([]interface{}, len(row.Values))}
+		for j, v := range row.Values {
+			if !math.IsNaN(v) {
+				rows[i].Values[j] = v
+			}
+		}
+	}
+	enc := json.NewEncoder(out)
+	enc.SetIndent("", "  ")
+	return enc.Encode(struct {
+		*queryResult
+		Rows []jsonRow `json:"rows"`
+	}{r, rows})
+}
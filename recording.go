@@ -0,0 +1,611 @@
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"math"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync/atomic"
+	"time"
+)
+
+// A recording is a directory of segment files. Each segment starts with a
+// header naming its metric columns and is followed by self-describing
+// blocks; a sidecar .idx file holds one fixed-size entry per block so
+// readers can find the blocks covering a time range without scanning.
+//
+// Raw blocks hold every sample. Rollup blocks hold one bucket per minute or
+// hour with count, min, max, sum and the elapsed-weighted sum of each
+// metric, which is energy in joules for the power rails.
+const (
+	segmentMagic = "MTOPREC1"
+	segmentExt   = ".seg"
+	indexExt     = ".idx"
+
+	blockRaw      uint8 = 0
+	blockRollup1m uint8 = 1
+	blockRollup1h uint8 = 2
+	blockMarkers  uint8 = 3
+)
+
+var (
+	rollupWidths = map[uint8]time.Duration{blockRollup1m: time.Minute, blockRollup1h: time.Hour}
+	blockMagic   = [3]byte{'B', 'L', 'K'}
+)
+
+type blockHeader struct {
+	Magic      [3]byte
+	Kind       uint8
+	Count      uint32
+	TMin, TMax int64 // unix nanoseconds
+	PayloadLen uint32
+	CRC        uint32
+}
+
+type indexEntry struct {
+	Kind       uint8
+	_          [3]byte
+	Count      uint32
+	TMin, TMax int64
+	Offset     int64 // of the block header
+	Length     uint32
+}
+
+// rollupBucket summarizes the samples in one fixed-width time bucket.
+type rollupBucket struct {
+	Start   int64
+	N       uint32
+	Elapsed float64
+	Min     [numMetrics]float64
+	Max     [numMetrics]float64
+	Sum     [numMetrics]float64
+	WSum    [numMetrics]float64 // sum of value*elapsed
+}
+
+func (b *rollupBucket) add(elapsed float64, v *[numMetrics]float64) {
+	for i := range v {
+		if b.N == 0 || v[i] < b.Min[i] {
+			b.Min[i] = v[i]
+		}
+		if b.N == 0 || v[i] > b.Max[i] {
+			b.Max[i] = v[i]
+		}
+		b.Sum[i] += v[i]
+		b.WSum[i] += v[i] * elapsed
+	}
+	b.N++
+	b.Elapsed += elapsed
+}
+
+// segmentWriter appends blocks to one segment and its index.
+type segmentWriter struct {
+	path        string
+	seg, idx    *os.File
+	offset      int64
+	first, last int64 // time span covered so far
+}
+
+func segmentPath(dir string, start time.Time) string {
+	return filepath.Join(dir, fmt.Sprintf("%d%s", start.UnixNano(), segmentExt))
+}
+
+func indexPath(segment string) string {
+	return strings.TrimSuffix(segment, segmentExt) + indexExt
+}
+
+func createSegment(path string) (*segmentWriter, error) {
+	seg, err := os.OpenFile(path, os.O_CREATE|os.O_WRONLY|os.O_EXCL, 0644)
+	if err != nil {
+		return nil, err
+	}
+	idx, err := os.OpenFile(indexPath(path), os.O_CREATE|os.O_WRONLY|os.O_TRUNC, 0644)
+	if err != nil {
+		seg.Close()
+		return nil, err
+	}
+	var hdr bytes.Buffer
+	hdr.WriteString(segmentMagic)
+	binary.Write(&hdr, binary.LittleEndian, uint16(numMetrics))
+	for _, name := range metricNames {
+		hdr.WriteByte(byte(len(name)))
+		hdr.WriteString(name)
+	}
+	if _, err := seg.Write(hdr.Bytes()); err != nil {
+		seg.Close()
+		idx.Close()
+		return nil, err
+	}
+	return &segmentWriter{path: path, seg: seg, idx: idx, offset: int64(hdr.Len())}, nil
+}
+
+func (w *segmentWriter) writeBlock(kind uint8, count int, tMin, tMax int64, payload []byte) error {
+	h := blockHeader{
+		Magic:      blockMagic,
+		Kind:       kind,
+		Count:      uint32(count),
+		TMin:       tMin,
+		TMax:       tMax,
+		PayloadLen: uint32(len(payload)),
+		CRC:        crc32.ChecksumIEEE(payload),
+	}
+	var buf bytes.Buffer
+	binary.Write(&buf, binary.LittleEndian, &h)
+	buf.Write(payload)
+	if _, err := w.seg.Write(buf.Bytes()); err != nil {
+		return err
+	}
+	e := indexEntry{Kind: kind, Count: uint32(count), TMin: tMin, TMax: tMax, Offset: w.offset, Length: uint32(buf.Len())}
+	if err := binary.Write(w.idx, binary.LittleEndian, &e); err != nil {
+		return err
+	}
+	w.offset += int64(buf.Len())
+	if w.first == 0 || tMin < w.first {
+		w.first = tMin
+	}
+	if tMax > w.last {
+		w.last = tMax
+	}
+	return nil
+}
+
+func (w *segmentWriter) size() int64 { return w.offset }
+
+func (w *segmentWriter) close() error {
+	w.idx.Close()
+	return w.seg.Close()
+}
+
+func encodeRaw(times []int64, elapsed []float64, cols *[numMetrics][]float64) []byte {
+	var buf bytes.Buffer
+	binary.Write(&buf, binary.LittleEndian, times)
+	binary.Write(&buf, binary.LittleEndian, elapsed)
+	for i := range cols {
+		binary.Write(&buf, binary.LittleEndian, cols[i])
+	}
+	return buf.Bytes()
+}
+
+func encodeRollups(buckets []rollupBucket) []byte {
+	var buf bytes.Buffer
+	for i := range buckets {
+		binary.Write(&buf, binary.LittleEndian, &buckets[i])
+	}
+	return buf.Bytes()
+}
+
+func encodeMarkers(markers []marker) []byte {
+	var buf bytes.Buffer
+	for _, m := range markers {
+		binary.Write(&buf, binary.LittleEndian, m.Time.UnixNano())
+		binary.Write(&buf, binary.LittleEndian, uint16(len(m.Label)))
+		buf.WriteString(m.Label)
+	}
+	return buf.Bytes()
+}
+
+// recorder writes the session to a recording directory from its own
+// goroutine. Samples are handed over with a reference held; when the
+// recorder falls behind, samples are dropped and counted instead of
+// stalling collection. A new segment is started every segmentSpan.
+type recorder struct {
+	dir     string
+	maxSize int64
+	in      chan *sample
+	marks   chan marker
+	stop    chan chan struct{}
+	quit    chan struct{}
+	dropped uint64
+	active  atomic.Value // path of the segment being written
+
+	seg     *segmentWriter
+	segSpan time.Time
+	times   []int64
+	elapsed []float64
+	cols    [numMetrics][]float64
+	rollups map[uint8]*rollupTier
+	markers []marker
+}
+
+type rollupTier struct {
+	width  time.Duration
+	cur    rollupBucket
+	done   []rollupBucket
+	perBlk int // buckets per block
+}
+
+func newRollupTiers() map[uint8]*rollupTier {
+	return map[uint8]*rollupTier{
+		blockRollup1m: {width: time.Minute, perBlk: 60},
+		blockRollup1h: {width: time.Hour, perBlk: 24},
+	}
+}
+
+func (t *rollupTier) add(ts int64, elapsed float64, v *[numMetrics]float64) {
+	start := time.Unix(0, ts).Truncate(t.width).UnixNano()
+	if t.cur.N > 0 && t.cur.Start != start {
+		t.done = append(t.done, t.cur)
+		t.cur = rollupBucket{}
+	}
+	t.cur.Start = start
+	t.cur.add(elapsed, v)
+}
+
+// finish closes the open bucket.
+func (t *rollupTier) finish() {
+	if t.cur.N > 0 {
+		t.done = append(t.done, t.cur)
+		t.cur = rollupBucket{}
+	}
+}
+
+var sessionRecorder *recorder
+
+// startRecorder begins a new segment in dir and starts the writer and the
+// background compactor. maxSize caps the recording's total size in bytes.
+func startRecorder(dir string, maxSize int64) (*recorder, error) {
+	if err := os.MkdirAll(dir, 0755); err != nil {
+		return nil, err
+	}
+	r := &recorder{
+		dir:     dir,
+		maxSize: maxSize,
+		in:      make(chan *sample, 64),
+		marks:   make(chan marker, 16),
+		stop:    make(chan chan struct{}),
+		quit:    make(chan struct{}),
+		rollups: newRollupTiers(),
+	}
+	now := sessionClock.Now()
+	seg, err := createSegment(segmentPath(dir, now))
+	if err != nil {
+		return nil, err
+	}
+	r.seg, r.segSpan = seg, now.Truncate(segmentSpan)
+	r.active.Store(seg.path)
+	go r.run()
+	go r.compactLoop()
+	return r, nil
+}
+
+func (r *recorder) observe(s *sample) {
+	s.retain()
+	select {
+	case r.in <- s:
+	default:
+		s.release()
+		atomic.AddUint64(&r.dropped, 1)
+	}
+}
+
+func (r *recorder) mark(m marker) {
+	select {
+	case r.marks <- m:
+	default:
+		atomic.AddUint64(&r.dropped, 1)
+	}
+}
+
+// close flushes everything buffered, waiting at most a second.
+func (r *recorder) close() {
+	ack := make(chan struct{})
+	select {
+	case r.stop <- ack:
+		select {
+		case <-ack:
+		case <-time.After(time.Second):
+		}
+	case <-time.After(time.Second):
+	}
+}
+
+func (r *recorder) run() {
+	for {
+		select {
+		case s := <-r.in:
+			r.add(s)
+			s.release()
+		case m := <-r.marks:
+			r.markers = append(r.markers, m)
+		case ack := <-r.stop:
+			for len(r.in) > 0 {
+				s := <-r.in
+				r.add(s)
+				s.release()
+			}
+			r.flush(true)
+			r.seg.close()
+			close(r.quit)
+			close(ack)
+			return
+		}
+	}
+}
+
+func (r *recorder) add(s *sample) {
+	if span := s.Time.Truncate(segmentSpan); !span.Equal(r.segSpan) {
+		r.rotate(s.Time)
+	}
+	ts := s.Time.UnixNano()
+	// Raw samples go out at every minute boundary so a crash loses little.
+	if len(r.times) > 0 && !time.Unix(0, r.times[0]).Truncate(time.Minute).Equal(s.Time.Truncate(time.Minute)) {
+		r.flush(false)
+	}
+	r.times = append(r.times, ts)
+	r.elapsed = append(r.elapsed, s.Elapsed)
+	for i := range r.cols {
+		r.cols[i] = append(r.cols[i], s.Values[i])
+	}
+	for _, t := range r.rollups {
+		t.add(ts, s.Elapsed, &s.Values)
+	}
+}
+
+// rotate finishes the current segment, rollups included, and continues in
+// a new one. If the new segment cannot be created the old one is kept.
+func (r *recorder) rotate(t time.Time) {
+	seg, err := createSegment(segmentPath(r.dir, t))
+	if err != nil {
+		stderrLogger.Errorf("recording: %v", err)
+		return
+	}
+	r.flush(true)
+	r.seg.close()
+	r.seg, r.segSpan = seg, t.Truncate(segmentSpan)
+	r.active.Store(seg.path)
+}
+
+// flush writes pending raw samples, markers and full rollup blocks; all
+// rollups, including open buckets, when final is set.
+func (r *recorder) flush(final bool) {
+	if n := len(r.times); n > 0 {
+		if err := r.seg.writeBlock(blockRaw, n, r.times[0], r.times[n-1], encodeRaw(r.times, r.elapsed, &r.cols)); err != nil {
+			stderrLogger.Errorf("recording: %v", err)
+		}
+		r.times, r.elapsed = r.times[:0], r.elapsed[:0]
+		for i := range r.cols {
+			r.cols[i] = r.cols[i][:0]
+		}
+	}
+	if len(r.markers) > 0 {
+		if err := r.seg.writeBlock(blockMarkers, len(r.markers), r.markers[0].Time.UnixNano(), r.markers[len(r.markers)-1].Time.UnixNano(), encodeMarkers(r.markers)); err != nil {
+			stderrLogger.Errorf("recording: %v", err)
+		}
+		r.markers = r.markers[:0]
+	}
+	for kind, t := range r.rollups {
+		if final {
+			t.finish()
+		}
+		if len(t.done) > 0 && (final || len(t.done) >= t.perBlk) {
+			if err := r.seg.writeBlock(kind, len(t.done), t.done[0].Start, t.done[len(t.done)-1].Start, encodeRollups(t.done)); err != nil {
+				stderrLogger.Errorf("recording: %v", err)
+			}
+			t.done = t.done[:0]
+		}
+	}
+}
+
+// segmentReader gives random access to the blocks of one segment.
+type segmentReader struct {
+	path    string
+	metrics []string // column names in file order
+	index   []indexEntry
+}
+
+// listSegments returns the segment files of a recording, oldest first.
+func listSegments(dir string) ([]string, error) {
+	current, _, err := scanSegments(dir)
+	return current, err
+}
+
+// scanSegments returns the current copy of every segment, oldest first, and
+// the copies a compaction has superseded but not yet removed.
+func scanSegments(dir string) (current, superseded []string, err error) {
+	paths, err := filepath.Glob(filepath.Join(dir, "*"+segmentExt))
+	if err != nil {
+		return nil, nil, err
+	}
+	if len(paths) == 0 {
+		return nil, nil, fmt.Errorf("no recording segments in %s", dir)
+	}
+	newest := make(map[string]string)
+	for _, p := range paths {
+		stem, gen := segmentGeneration(p)
+		if cur, ok := newest[stem]; ok {
+			if _, curGen := segmentGeneration(cur); curGen >= gen {
+				superseded = append(superseded, p)
+				continue
+			}
+			superseded = append(superseded, cur)
+		}
+		newest[stem] = p
+	}
+	for _, p := range newest {
+		current = append(current, p)
+	}
+	sort.Slice(current, func(i, j int) bool {
+		return filepath.Base(current[i]) < filepath.Base(current[j])
+	})
+	return current, superseded, nil
+}
+
+// segmentGeneration splits a segment path into its start stamp and the
+// number of times it has been compacted. Each compaction writes the next
+// name, "<stamp>-c.seg", then "<stamp>-cc.seg", beside the previous copy.
+func segmentGeneration(path string) (stem string, gen int) {
+	stem = strings.TrimSuffix(filepath.Base(path), segmentExt)
+	if i := strings.Index(stem, compactedSuffix); i >= 0 {
+		return stem[:i], len(stem) - i - 1
+	}
+	return stem, 0
+}
+
+// openRecording opens every readable segment of a recording and returns
+// them with the time span their blocks cover. Unreadable segments are
+// skipped with a warning.
+func openRecording(dir string) (segs []*segmentReader, first, last int64, err error) {
+	paths, err := listSegments(dir)
+	if err != nil {
+		return nil, 0, 0, err
+	}
+	first, last = math.MaxInt64, math.MinInt64
+	for _, p := range paths {
+		r, err := openSegment(p)
+		if err != nil {
+			fmt.Fprintln(os.Stderr, "Warning: skipping", err)
+			continue
+		}
+		for _, e := range r.index {
+			if e.TMin < first {
+				first = e.TMin
+			}
+			if e.TMax > last {
+				last = e.TMax
+			}
+		}
+		segs = append(segs, r)
+	}
+	if len(segs) == 0 || first > last {
+		return nil, 0, 0, errors.New("recording is empty")
+	}
+	return segs, first, last, nil
+}
+
+func openSegment(path string) (*segmentReader, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+	br := bufio.NewReader(f)
+	magic := make([]byte, len(segmentMagic))
+	if _, err := io.ReadFull(br, magic); err != nil || string(magic) != segmentMagic {
+		return nil, fmt.Errorf("%s: not a mactop recording segment", path)
+	}
+	var n uint16
+	if err := binary.Read(br, binary.LittleEndian, &n); err != nil {
+		return nil, err
+	}
+	r := &segmentReader{path: path}
+	for i := 0; i < int(n); i++ {
+		l, err := br.ReadByte()
+		if err != nil {
+			return nil, err
+		}
+		name := make([]byte, l)
+		if _, err := io.ReadFull(br, name); err != nil {
+			return nil, err
+		}
+		r.metrics = append(r.metrics, string(name))
+	}
+	idx, err := os.ReadFile(indexPath(path))
+	if err != nil {
+		return nil, err
+	}
+	entrySize := binary.Size(indexEntry{})
+	r.index = make([]indexEntry, len(idx)/entrySize) // a torn last entry is ignored
+	if err := binary.Read(bytes.NewReader(idx[:len(r.index)*entrySize]), binary.LittleEndian, r.index); err != nil {
+		return nil, err
+	}
+	return r, nil
+}
+
+// blocks returns the index entries of one kind overlapping [from, to].
+func (r *segmentReader) blocks(kind uint8, from, to int64) []indexEntry {
+	var out []indexEntry
+	for _, e := range r.index {
+		if e.Kind == kind && e.TMax >= from && e.TMin <= to {
+			out = append(out, e)
+		}
+	}
+	return out
+}
+
+// readBlock loads and verifies one block's payload.
+func (r *segmentReader) readBlock(f *os.File, e indexEntry) (blockHeader, []byte, error) {
+	buf := make([]byte, e.Length)
+	if _, err := f.ReadAt(buf, e.Offset); err != nil {
+		return blockHeader{}, nil, err
+	}
+	var h blockHeader
+	hs := binary.Size(h)
+	if err := binary.Read(bytes.NewReader(buf[:hs]), binary.LittleEndian, &h); err != nil {
+		return h, nil, err
+	}
+	payload := buf[hs:]
+	if h.Magic != blockMagic || int(h.PayloadLen) != len(payload) || crc32.ChecksumIEEE(payload) != h.CRC {
+		return h, nil, errors.New("corrupt block")
+	}
+	return h, payload, nil
+}
+
+// decodeRaw splits a raw payload into its time, elapsed and metric columns.
+func (r *segmentReader) decodeRaw(count int, payload []byte) ([]int64, []float64, [][]float64, error) {
+	rd := bytes.NewReader(payload)
+	times := make([]int64, count)
+	elapsed := make([]float64, count)
+	cols := make([][]float64, len(r.metrics))
+	if err := binary.Read(rd, binary.LittleEndian, times); err != nil {
+		return nil, nil, nil, err
+	}
+	if err := binary.Read(rd, binary.LittleEndian, elapsed); err != nil {
+		return nil, nil, nil, err
+	}
+	for i := range cols {
+		cols[i] = make([]float64, count)
+		if err := binary.Read(rd, binary.LittleEndian, cols[i]); err != nil {
+			return nil, nil, nil, err
+		}
+	}
+	return times, elapsed, cols, nil
+}
+
+// decodeRollups reads rollup buckets. Rollup layout depends on numMetrics,
+// so only segments written with the current metric set can be decoded.
+func (r *segmentReader) decodeRollups(count int, payload []byte) ([]rollupBucket, error) {
+	if len(r.metrics) != int(numMetrics) {
+		return nil, fmt.Errorf("%s: rollups written with %d metrics, expected %d", r.path, len(r.metrics), numMetrics)
+	}
+	buckets := make([]rollupBucket, count)
+	err := binary.Read(bytes.NewReader(payload), binary.LittleEndian, buckets)
+	return buckets, err
+}
+
+func decodeMarkers(count int, payload []byte) ([]marker, error) {
+	rd := bytes.NewReader(payload)
+	out := make([]marker, 0, count)
+	for i := 0; i < count; i++ {
+		var ts int64
+		var l uint16
+		if err := binary.Read(rd, binary.LittleEndian, &ts); err != nil {
+			return nil, err
+		}
+		if err := binary.Read(rd, binary.LittleEndian, &l); err != nil {
+			return nil, err
+		}
+		label := make([]byte, l)
+		if _, err := io.ReadFull(rd, label); err != nil {
+			return nil, err
+		}
+		out = append(out, marker{Time: time.Unix(0, ts), Label: string(label)})
+	}
+	return out, nil
+}
+
+// metricColumn maps a metric name to its column in this segment.
+func (r *segmentReader) metricColumn(name string) int {
+	for i, n := range r.metrics {
+		if n == name {
+			return i
+		}
+	}
+	return -1
+}
@@ -0,0 +1,165 @@
+package main
+
+import (
+	"math"
+	"os"
+	"strings"
+	"testing"
+	"time"
+)
+
+var recordingBase = time.Date(2026, 1, 1, 10, 0, 0, 0, time.UTC)
+
+// writeTestRecording records two hours of one-second samples into dir, with
+// PackageW cycling through 0..59 every minute, and one marker.
+func writeTestRecording(t *testing.T, dir string) {
+	t.Helper()
+	seg, err := createSegment(segmentPath(dir, recordingBase))
+	if err != nil {
+		t.Fatal(err)
+	}
+	r := &recorder{dir: dir, rollups: newRollupTiers(), seg: seg, segSpan: recordingBase.Truncate(segmentSpan)}
+	var s sample
+	for i := 0; i < 2*3600; i++ {
+		s.Time = recordingBase.Add(time.Duration(i) * time.Second)
+		s.Elapsed = 1
+		s.Values[metricPackageW] = float64(i % 60)
+		r.add(&s)
+		if i == 90 {
+			r.markers = append(r.markers, marker{Time: s.Time, Label: "build"})
+		}
+	}
+	r.flush(true)
+	r.seg.close()
+}
+
+func TestRecordingRoundTrip(t *testing.T) {
+	dir := t.TempDir()
+	writeTestRecording(t, dir)
+	segs, first, last, err := openRecording(dir)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(segs) != 2 || first != recordingBase.UnixNano() || last != recordingBase.Add(2*time.Hour-time.Second).UnixNano() {
+		t.Fatalf("%d segments spanning %v..%v", len(segs), time.Unix(0, first).UTC(), time.Unix(0, last).UTC())
+	}
+
+	counts := make(map[uint8]int)
+	for _, r := range segs {
+		f, err := os.Open(r.path)
+		if err != nil {
+			t.Fatal(err)
+		}
+		pw := r.metricColumn("PackageW")
+		for _, e := range r.index {
+			h, payload, err := r.readBlock(f, e)
+			if err != nil {
+				t.Fatal(err)
+			}
+			counts[e.Kind] += int(h.Count)
+			switch e.Kind {
+			case blockRaw:
+				times, elapsed, cols, err := r.decodeRaw(int(h.Count), payload)
+				if err != nil {
+					t.Fatal(err)
+				}
+				for j, ts := range times {
+					i := int(time.Duration(ts-recordingBase.UnixNano()) / time.Second)
+					if elapsed[j] != 1 || cols[pw][j] != float64(i%60) {
+						t.Fatalf("raw sample %d: elapsed %v PackageW %v", i, elapsed[j], cols[pw][j])
+					}
+				}
+			case blockRollup1m, blockRollup1h:
+				buckets, err := r.decodeRollups(int(h.Count), payload)
+				if err != nil {
+					t.Fatal(err)
+				}
+				for _, b := range buckets {
+					if b.Min[metricPackageW] != 0 || b.Max[metricPackageW] != 59 || b.Sum[metricPackageW] != float64(b.N)*29.5 || b.WSum[metricPackageW] != b.Sum[metricPackageW] {
+						t.Fatalf("rollup %+v", b)
+					}
+				}
+			case blockMarkers:
+				markers, err := decodeMarkers(int(h.Count), payload)
+				if err != nil {
+					t.Fatal(err)
+				}
+				if len(markers) != 1 || markers[0].Label != "build" || !markers[0].Time.Equal(recordingBase.Add(90*time.Second)) {
+					t.Fatalf("markers %+v", markers)
+				}
+			}
+		}
+		f.Close()
+	}
+	if counts[blockRaw] != 2*3600 || counts[blockRollup1m] != 120 || counts[blockRollup1h] != 2 || counts[blockMarkers] != 1 {
+		t.Errorf("block counts %v", counts)
+	}
+}
+
+func TestQueryRecording(t *testing.T) {
+	dir := t.TempDir()
+	writeTestRecording(t, dir)
+
+	// A third hour as retention leaves it: minute rollups only.
+	seg, err := createSegment(segmentPath(dir, recordingBase.Add(2*time.Hour)))
+	if err != nil {
+		t.Fatal(err)
+	}
+	tier := newRollupTiers()[blockRollup1m]
+	var v [numMetrics]float64
+	for i := 0; i < 3600; i++ {
+		v[metricPackageW] = 100
+		tier.add(recordingBase.Add(2*time.Hour+time.Duration(i)*time.Second).UnixNano(), 1, &v)
+	}
+	tier.finish()
+	if err := seg.writeBlock(blockRollup1m, len(tier.done), tier.done[0].Start, tier.done[len(tier.done)-1].Start, encodeRollups(tier.done)); err != nil {
+		t.Fatal(err)
+	}
+	seg.close()
+
+	segs, _, _, err := openRecording(dir)
+	if err != nil {
+		t.Fatal(err)
+	}
+	at := func(d time.Duration) time.Time { return recordingBase.Add(d) }
+	for _, c := range []struct {
+		from, to time.Time
+		step     time.Duration
+		agg      string
+		tier     string
+		want     []float64
+	}{
+		{at(0), at(2*time.Hour - 1), time.Hour, "mean", "1h", []float64{29.5, 29.5}},
+		{at(0), at(3*time.Minute - 1), time.Minute, "max", "1m", []float64{59, 59, 59}},
+		{at(0), at(time.Hour - 1), 0, "p50", "raw", []float64{29}},
+		{at(0), at(2*time.Hour - 1), 0, "energy", "raw", []float64{2 * 60 * 1770}},
+		{at(2 * time.Hour), at(3*time.Hour - 1), 0, "mean", "1m", []float64{100}},
+		{at(0), at(3*time.Hour - 1), 0, "max", "raw+1m", []float64{100}},
+		// The rollup-only hour is skipped rather than read as bucket means.
+		{at(0), at(3*time.Hour - 1), 0, "p100", "raw", []float64{59}},
+	} {
+		res, err := queryRecording(segs, []string{"PackageW"}, c.from, c.to, c.step, c.agg)
+		if err != nil {
+			t.Errorf("%s step %v: %v", c.agg, c.step, err)
+			continue
+		}
+		var got []float64
+		for _, row := range res.Rows {
+			got = append(got, row.Values[0])
+		}
+		if res.Tier != c.tier || len(got) != len(c.want) {
+			t.Errorf("%s step %v: tier %q rows %v, want %q %v", c.agg, c.step, res.Tier, got, c.tier, c.want)
+			continue
+		}
+		for i := range got {
+			if math.Abs(got[i]-c.want[i]) > 1e-9 {
+				t.Errorf("%s step %v: rows %v, want %v", c.agg, c.step, got, c.want)
+				break
+			}
+		}
+	}
+
+	if _, err := queryRecording(segs, []string{"PackageW"}, at(2*time.Hour), at(3*time.Hour-1), 0, "p95"); err == nil || !strings.Contains(err.Error(), "rollups") {
+		t.Errorf("p95 over rollups only: %v", err)
+	}
+}
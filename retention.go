@@ -0,0 +1,263 @@
+package main
+
+import (
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"time"
+)
+
+// Recordings are kept bounded without outside help: segments older than
+// rawRetention are rewritten without raw samples, segments older than
+// minuteRetention keep only hourly rollups and markers, and the oldest
+// segments are deleted once the recording exceeds its size cap.
+const (
+	segmentSpan     = time.Hour
+	rawRetention    = 24 * time.Hour
+	minuteRetention = 30 * 24 * time.Hour
+	compactEvery    = 10 * time.Minute
+	compactPause    = 200 * time.Millisecond // between segments; the only throttle, priority is unchanged
+	compactedSuffix = "-c"
+)
+
+var recordMaxSizeMB = 1024
+
+// compactLoop runs the compactor now and every compactEvery until the
+// recorder stops. It only touches finished segments, so it never waits on
+// or blocks the writer.
+func (r *recorder) compactLoop() {
+	timer := sessionClock.NewTimer(compactEvery)
+	defer timer.Stop()
+	for {
+		if err := compactRecording(r.dir, r.active.Load().(string), sessionClock.Now(), r.maxSize, r.quit); err != nil {
+			stderrLogger.Errorf("recording compaction: %v", err)
+		}
+		select {
+		case <-timer.C():
+			timer.Reset(compactEvery)
+		case <-r.quit:
+			return
+		}
+	}
+}
+
+type segmentInfo struct {
+	path       string
+	size       int64
+	end        time.Time
+	raw, multi bool // holds raw samples / 1-minute rollups
+}
+
+func statSegment(path string) (segmentInfo, error) {
+	info := segmentInfo{path: path}
+	r, err := openSegment(path)
+	if err != nil {
+		return info, err
+	}
+	for _, e := range r.index {
+		if t := time.Unix(0, e.TMax); t.After(info.end) {
+			info.end = t
+		}
+		info.raw = info.raw || e.Kind == blockRaw
+		info.multi = info.multi || e.Kind == blockRollup1m
+	}
+	info.size = fileSizes(path, indexPath(path))
+	return info, nil
+}
+
+// fileSizes is the total size of the files that exist among paths.
+func fileSizes(paths ...string) int64 {
+	var n int64
+	for _, p := range paths {
+		if st, err := os.Stat(p); err == nil {
+			n += st.Size()
+		}
+	}
+	return n
+}
+
+// compactRecording applies the retention policy to every segment but the
+// active one, then enforces maxSize by deleting the oldest segments. A
+// segment that cannot be read or compacted (corrupt, or the disk is full)
+// is logged and counted at its current size, so the size cap is enforced
+// regardless.
+func compactRecording(dir, active string, now time.Time, maxSize int64, quit <-chan struct{}) error {
+	paths, superseded, err := scanSegments(dir)
+	if err != nil {
+		return nil // nothing recorded yet
+	}
+	for _, path := range superseded { // left by a compaction cut short
+		os.Remove(path)
+		os.Remove(indexPath(path))
+	}
+	var segs []segmentInfo
+	var total int64
+	for _, path := range paths {
+		if path == active {
+			total += fileSizes(path, indexPath(path))
+			continue
+		}
+		info, err := statSegment(path)
+		if err != nil {
+			stderrLogger.Errorf("recording: %v", err)
+			info = segmentInfo{path: path, size: fileSizes(path, indexPath(path))}
+			if st, err := os.Stat(path); err == nil {
+				info.end = st.ModTime()
+			}
+			segs = append(segs, info)
+			total += info.size
+			continue
+		}
+		age := now.Sub(info.end)
+		if (info.raw && age > rawRetention) || (info.multi && age > minuteRetention) {
+			select {
+			case <-quit:
+				return nil
+			case <-time.After(compactPause):
+			}
+			if compacted, err := compactSegment(info.path, age <= minuteRetention); err != nil {
+				stderrLogger.Errorf("recording: compacting %s: %v", filepath.Base(info.path), err)
+			} else if cinfo, err := statSegment(compacted); err != nil {
+				stderrLogger.Errorf("recording: %v", err)
+				info = segmentInfo{path: compacted, size: fileSizes(compacted, indexPath(compacted)), end: info.end}
+			} else {
+				info = cinfo
+			}
+		}
+		segs = append(segs, info)
+		total += info.size
+	}
+	sort.Slice(segs, func(i, j int) bool { return segs[i].end.Before(segs[j].end) })
+	for _, info := range segs {
+		if total <= maxSize {
+			break
+		}
+		os.Remove(info.path)
+		os.Remove(indexPath(info.path))
+		total -= info.size
+	}
+	return nil
+}
+
+// compactSegment rewrites a segment without raw samples, and without
+// 1-minute rollups unless keepMinute is set. Rollups are rebuilt from the
+// raw samples when present, so segments cut short by a crash still get
+// them. The new segment is assembled in a staging directory and moved in
+// under the next compacted name before the old one is removed, so a
+// concurrent query sees either the old data or the new, and a crash at
+// any point leaves at least one complete copy.
+func compactSegment(path string, keepMinute bool) (string, error) {
+	r, err := openSegment(path)
+	if err != nil {
+		return "", err
+	}
+	f, err := os.Open(path)
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+
+	dir := filepath.Dir(path)
+	stem, gen := segmentGeneration(path)
+	name := stem + "-" + strings.Repeat("c", gen+1) + segmentExt
+	staging := filepath.Join(dir, ".compact")
+	if err := os.MkdirAll(staging, 0755); err != nil {
+		return "", err
+	}
+	tmp := filepath.Join(staging, name)
+	os.Remove(tmp)
+	w, err := createSegment(tmp)
+	if err != nil {
+		return "", err
+	}
+	defer os.Remove(indexPath(tmp)) // no-ops once moved in; frees the space on failure
+	defer os.Remove(tmp)
+
+	tiers := newRollupTiers()
+	hasRaw := false
+	for _, e := range r.index {
+		hasRaw = hasRaw || e.Kind == blockRaw
+	}
+	for _, e := range r.index {
+		h, payload, err := r.readBlock(f, e)
+		if err != nil {
+			continue // drop what cannot be verified
+		}
+		switch {
+		case h.Kind == blockMarkers:
+			err = w.writeBlock(h.Kind, int(h.Count), h.TMin, h.TMax, payload)
+		case h.Kind == blockRaw:
+			err = r.rollupRaw(int(h.Count), payload, tiers)
+		case !hasRaw && (h.Kind == blockRollup1h || (h.Kind == blockRollup1m && keepMinute)):
+			err = w.writeBlock(h.Kind, int(h.Count), h.TMin, h.TMax, payload)
+		}
+		if err != nil {
+			w.close()
+			return "", err
+		}
+	}
+	for kind, t := range tiers {
+		if kind == blockRollup1m && !keepMinute {
+			continue
+		}
+		t.finish()
+		for len(t.done) > 0 {
+			n := len(t.done)
+			if n > t.perBlk {
+				n = t.perBlk
+			}
+			if err := w.writeBlock(kind, n, t.done[0].Start, t.done[n-1].Start, encodeRollups(t.done[:n])); err != nil {
+				w.close()
+				return "", err
+			}
+			t.done = t.done[n:]
+		}
+	}
+	if err := w.close(); err != nil {
+		return "", err
+	}
+
+	// New index first (unused without its segment), then the new segment,
+	// which readers prefer over the old copy from then on; only then drop
+	// the old pair. A crash in between leaves both, and the next run
+	// removes the superseded one.
+	dst := filepath.Join(dir, name)
+	if err := os.Rename(indexPath(tmp), indexPath(dst)); err != nil {
+		return "", err
+	}
+	if err := os.Rename(tmp, dst); err != nil {
+		os.Remove(indexPath(dst))
+		return "", err
+	}
+	os.Remove(path)
+	os.Remove(indexPath(path))
+	return dst, nil
+}
+
+// rollupRaw folds a raw block into rollup tiers, matching columns by name.
+func (r *segmentReader) rollupRaw(count int, payload []byte, tiers map[uint8]*rollupTier) error {
+	times, elapsed, cols, err := r.decodeRaw(count, payload)
+	if err != nil {
+		return err
+	}
+	ids := make([]int, len(r.metrics))
+	for c, name := range r.metrics {
+		ids[c] = -1
+		if id, ok := metricByName(name); ok {
+			ids[c] = int(id)
+		}
+	}
+	var v [numMetrics]float64
+	for j, ts := range times {
+		for c, id := range ids {
+			if id >= 0 {
+				v[id] = cols[c][j]
+			}
+		}
+		for _, t := range tiers {
+			t.add(ts, elapsed[j], &v)
+		}
+	}
+	return nil
+}
@@ -0,0 +1,100 @@
+package main
+
+import "time"
+
+// scheduler runs all periodic UI-side work from the goroutine that owns the
+// widgets. Periods are quantized to a base tick and every task is aligned to
+// a multiple of its own period, so tasks with related periods come due on
+// the same tick and share one timer wakeup. The timer is only armed for the
+// next tick that has work; idle ticks cost nothing.
+type scheduler struct {
+	clock clock
+	tick  time.Duration
+	start time.Time
+	tasks []*schedTask
+	timer clockTimer
+
+	C <-chan time.Time
+}
+
+type schedTask struct {
+	name   string
+	period int64 // in ticks
+	due    int64 // absolute tick
+	run    func()
+}
+
+func newScheduler(clk clock, tick time.Duration) *scheduler {
+	timer := clk.NewTimer(time.Hour)
+	timer.Stop()
+	return &scheduler{
+		clock: clk,
+		tick:  tick,
+		start: clk.Now(),
+		timer: timer,
+		C:     timer.C(),
+	}
+}
+
+func (s *scheduler) ticks(period time.Duration) int64 {
+	n := int64((period + s.tick/2) / s.tick)
+	if n < 1 {
+		n = 1
+	}
+	return n
+}
+
+func (s *scheduler) now() int64 {
+	return int64(s.clock.Now().Sub(s.start) / s.tick)
+}
+
+// every registers run to be called once per period.
+func (s *scheduler) every(name string, period time.Duration, run func()) {
+	t := &schedTask{name: name, period: s.ticks(period), run: run}
+	t.due = (s.now()/t.period + 1) * t.period
+	s.tasks = append(s.tasks, t)
+	s.arm()
+}
+
+// setPeriod changes a task's period, e.g. to slow rendering down on battery.
+func (s *scheduler) setPeriod(name string, period time.Duration) {
+	for _, t := range s.tasks {
+		if t.name == name {
+			t.period = s.ticks(period)
+			t.due = (s.now()/t.period + 1) * t.period
+		}
+	}
+	s.arm()
+}
+
+// fire runs every task that is due and re-arms the timer. Call it whenever
+// C delivers. A late wakeup runs each due task once rather than catching up.
+func (s *scheduler) fire() {
+	now := s.now()
+	for _, t := range s.tasks {
+		if t.due <= now {
+			t.run()
+			t.due = (now/t.period + 1) * t.period
+		}
+	}
+	s.arm()
+}
+
+func (s *scheduler) arm() {
+	if len(s.tasks) == 0 {
+		return
+	}
+	next := s.tasks[0].due
+	for _, t := range s.tasks[1:] {
+		if t.due < next {
+			next = t.due
+		}
+	}
+	if !s.timer.Stop() {
+		select {
+		case <-s.timer.C():
+		default:
+		}
+	}
+	s.timer.Reset(s.start.Add(time.Duration(next) * s.tick).Sub(s.clock.Now()))
+}
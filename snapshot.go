@@ -0,0 +1,86 @@
+package main
+
+import (
+	"sync/atomic"
+	"time"
+)
+
+// sample is one complete powermetrics sample, assembled at the sample
+// boundary. Samples are recycled through samplePool: every slice is sized
+// from the topology once and reused, so steady-state collection does not
+// allocate. A consumer that keeps a sample beyond the call that handed it
+// over must retain it and release it when done.
+type sample struct {
+	Time      time.Time
+	Elapsed   float64 // seconds covered, as reported by powermetrics
+	CPU       CPUMetrics
+	GPU       GPUMetrics
+	NetDisk   NetDiskMetrics
+	Values    [numMetrics]float64
+	Processes []ProcessMetrics // sorted by CPU usage, highest first
+
+	refs int32
+	pool *samplePool
+}
+
+func (s *sample) retain() {
+	atomic.AddInt32(&s.refs, 1)
+}
+
+func (s *sample) release() {
+	if atomic.AddInt32(&s.refs, -1) == 0 && s.pool != nil {
+		s.pool.put(s)
+	}
+}
+
+// samplePool is a bounded free list of samples. When it runs dry (a slow
+// consumer is holding many samples) it allocates rather than blocking.
+type samplePool struct {
+	free      chan *sample
+	cores     int
+	processes int
+}
+
+func newSamplePool(size, cores, processes int) *samplePool {
+	p := &samplePool{free: make(chan *sample, size), cores: cores, processes: processes}
+	for i := 0; i < size; i++ {
+		p.free <- p.alloc()
+	}
+	return p
+}
+
+func (p *samplePool) alloc() *sample {
+	return &sample{
+		CPU: CPUMetrics{
+			ECores: make([]int, 0, p.cores),
+			PCores: make([]int, 0, p.cores),
+		},
+		Processes: make([]ProcessMetrics, 0, p.processes),
+		pool:      p,
+	}
+}
+
+// get returns a cleared sample holding one reference.
+func (p *samplePool) get() *sample {
+	var s *sample
+	select {
+	case s = <-p.free:
+	default:
+		s = p.alloc()
+	}
+	eCores, pCores, procs := s.CPU.ECores[:0], s.CPU.PCores[:0], s.Processes[:0]
+	*s = sample{
+		CPU:       CPUMetrics{ECores: eCores, PCores: pCores},
+		Processes: procs,
+		refs:      1,
+		pool:      p,
+	}
+	return s
+}
+
+func (p *samplePool) put(s *sample) {
+	select {
+	case p.free <- s:
+	default: // pool is full, let the GC have it
+	}
+}
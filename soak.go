@@ -0,0 +1,346 @@
+package main
+
+import (
+	"fmt"
+	"net"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"strconv"
+	"strings"
+	"time"
+
+	w "github.com/gizak/termui/v3/widgets"
+)
+
+// soakLimits are the absolute bounds a soak run asserts at every check.
+type soakLimits struct {
+	heapMB, rssMB   int
+	goroutines, fds int
+}
+
+// soakGrowth is how much each measure may grow from the end of the warm-up
+// to the end of the run, when caches, rings and tables are long full.
+// Steady growth past that is a leak, whatever the absolute bounds say.
+var soakGrowth = struct {
+	heapMB, rssMB   float64
+	goroutines, fds int
+	processes       int
+}{heapMB: 16, rssMB: 32, goroutines: 2, fds: 2, processes: 16}
+
+type soakStats struct {
+	heapMB, rssMB   float64
+	goroutines, fds int
+	processes       int // process names held by the intern table
+	procHistory     int // processes with a sparkline ring
+	profile         int // processes in the --pprof profile
+	history         int
+	powerValues     int
+}
+
+func readSoakStats() soakStats {
+	var ms runtime.MemStats
+	runtime.ReadMemStats(&ms)
+	st := soakStats{
+		heapMB:      float64(ms.HeapAlloc) / (1 << 20),
+		rssMB:       float64(currentRSS()) / (1 << 20),
+		goroutines:  runtime.NumGoroutine(),
+		powerValues: len(powerValues),
+	}
+	if fds, err := os.ReadDir("/dev/fd"); err == nil {
+		st.fds = len(fds) - 1 // the directory handle itself
+	}
+	processNames.mu.Lock()
+	st.processes = len(processNames.names)
+	processNames.mu.Unlock()
+	st.procHistory = len(processHistory.tracked) // same goroutine as updateProcessUI
+	if sessionProfile != nil {
+		sessionProfile.mu.Lock()
+		st.profile = len(sessionProfile.procs)
+		sessionProfile.mu.Unlock()
+	}
+	sessionHistory.mu.RLock()
+	st.history = sessionHistory.n
+	sessionHistory.mu.RUnlock()
+	return st
+}
+
+// currentRSS returns the resident set size in bytes, 0 if unknown.
+// Getrusage only reports the peak, which can never shrink.
+func currentRSS() int64 {
+	if runtime.GOOS == "linux" {
+		b, err := os.ReadFile("/proc/self/statm")
+		if f := strings.Fields(string(b)); err == nil && len(f) > 1 {
+			pages, _ := strconv.ParseInt(f[1], 10, 64)
+			return pages * int64(os.Getpagesize())
+		}
+		return 0
+	}
+	out, err := exec.Command("ps", "-o", "rss=", "-p", strconv.Itoa(os.Getpid())).Output()
+	if err != nil {
+		return 0
+	}
+	kb, _ := strconv.ParseInt(strings.TrimSpace(string(out)), 10, 64)
+	return kb << 10
+}
+
+// violations lists every absolute bound st exceeds.
+func (st soakStats) violations(l soakLimits) []string {
+	var v []string
+	check := func(name string, got float64, limit int) {
+		if limit > 0 && got > float64(limit) {
+			v = append(v, fmt.Sprintf("%s %.0f > %d", name, got, limit))
+		}
+	}
+	check("heap MB", st.heapMB, l.heapMB)
+	check("RSS MB", st.rssMB, l.rssMB)
+	check("goroutines", float64(st.goroutines), l.goroutines)
+	check("open fds", float64(st.fds), l.fds)
+	return v
+}
+
+// growth lists every measure that grew more than soakGrowth allows from
+// base, taken after the warm-up, to st.
+func (st soakStats) growth(base soakStats) []string {
+	var v []string
+	check := func(name string, from, to, allowed float64) {
+		if to-from > allowed {
+			v = append(v, fmt.Sprintf("%s grew %.1f -> %.1f", name, from, to))
+		}
+	}
+	check("heap MB", base.heapMB, st.heapMB, soakGrowth.heapMB)
+	if base.rssMB > 0 && st.rssMB > 0 {
+		check("RSS MB", base.rssMB, st.rssMB, soakGrowth.rssMB)
+	}
+	check("goroutines", float64(base.goroutines), float64(st.goroutines), float64(soakGrowth.goroutines))
+	check("open fds", float64(base.fds), float64(st.fds), float64(soakGrowth.fds))
+	check("process names", float64(base.processes), float64(st.processes), float64(soakGrowth.processes))
+	return v
+}
+
+// runSoak implements `mactop soak`: it drives the collection pipeline,
+// without the terminal UI, until the samples cover the requested simulated
+// duration, checking resource bounds as it goes and growth since the
+// warm-up at the end. Put the fake powermetrics first on PATH; it is told
+// to run at the requested speed. Session time is a virtual clock moved by
+// each sample's elapsed time, so rollups, recording segments and retention
+// see the simulated timeline. The recorder, both exporters and the energy
+// profile run unless given elsewhere, into a temporary directory and a
+// local UDP sink.
+func runSoak(args []string) int {
+	hours, speed, warmup := 24.0, 1000.0, 0.1
+	checkEvery := 5 * time.Second
+	limits := soakLimits{heapMB: 256, rssMB: 512, goroutines: 64, fds: 64}
+	model := "Apple M2 Pro"
+	for i := 0; i < len(args); i++ {
+		if i+1 >= len(args) {
+			fmt.Println("Error:", args[i], "requires a value")
+			return 1
+		}
+		arg, value := args[i], args[i+1]
+		i++
+		var err error
+		switch arg {
+		case "--hours":
+			hours, err = strconv.ParseFloat(value, 64)
+		case "--speed":
+			speed, err = strconv.ParseFloat(value, 64)
+		case "--interval":
+			updateInterval, err = strconv.Atoi(value)
+		case "--check":
+			checkEvery, err = time.ParseDuration(value)
+		case "--warmup":
+			warmup, err = strconv.ParseFloat(value, 64)
+		case "--model":
+			model = value
+		case "--record":
+			recordDir = value
+		case "--statsd":
+			statsdTarget = value
+		case "--influx":
+			influxTarget = value
+		case "--pprof":
+			pprofPath = value
+		case "--max-heap-mb":
+			limits.heapMB, err = strconv.Atoi(value)
+		case "--max-rss-mb":
+			limits.rssMB, err = strconv.Atoi(value)
+		case "--max-goroutines":
+			limits.goroutines, err = strconv.Atoi(value)
+		case "--max-fds":
+			limits.fds, err = strconv.Atoi(value)
+		default:
+			fmt.Println("Usage: mactop soak [--hours 24] [--speed 1000] [--interval ms] [--check 5s] [--warmup 0.1] [--model name]")
+			fmt.Println("                   [--record dir] [--statsd addr] [--influx target] [--pprof file]")
+			fmt.Println("                   [--max-heap-mb 256] [--max-rss-mb 512] [--max-goroutines 64] [--max-fds 64]")
+			return 1
+		}
+		if err != nil || updateInterval <= 0 || speed <= 0 || warmup < 0 || warmup >= 1 {
+			fmt.Printf("Error: invalid %s %q\n", arg, value)
+			return 1
+		}
+	}
+	if os.Getenv("FAKE_POWERMETRICS_SPEED") == "" {
+		os.Setenv("FAKE_POWERMETRICS_SPEED", strconv.FormatFloat(speed, 'f', -1, 64))
+	}
+	if os.Getenv("FAKE_POWERMETRICS_CHURN") == "" {
+		os.Setenv("FAKE_POWERMETRICS_CHURN", "0.2")
+	}
+	if devnull, err := os.OpenFile(os.DevNull, os.O_WRONLY, 0); err == nil {
+		stderrLogger.setOutput(devnull)
+	}
+
+	// The UI update functions run as usual; nothing is drawn.
+	cpu1Gauge, cpu2Gauge, aneGauge, gpuGauge, memoryGauge = w.NewGauge(), w.NewGauge(), w.NewGauge(), w.NewGauge(), w.NewGauge()
+	PowerChart, NetworkInfo, ProcessInfo = w.NewParagraph(), w.NewParagraph(), w.NewParagraph()
+	TotalPowerChart = w.NewBarChart()
+
+	vclock := newVirtualClock(time.Now())
+	sessionClock.set(vclock)
+	onSampleBoundary = vclock.Advance // read only by the collector, started below
+	simStart := vclock.Now()
+	sessionTotals.Lock()
+	sessionTotals.start = simStart
+	sessionTotals.Unlock()
+	lastUpdateTime = simStart
+	sched := newScheduler(vclock, 50*time.Millisecond)
+	sched.every("power-rollup", 2*time.Second, func() { rollupTotalPowerChart() })
+
+	tmp, err := os.MkdirTemp("", "mactop-soak-")
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	defer os.RemoveAll(tmp)
+	if recordDir == "" {
+		recordDir = filepath.Join(tmp, "recording")
+	}
+	if pprofPath == "" {
+		pprofPath = filepath.Join(tmp, "energy.pprof")
+	}
+	if statsdTarget == "" || influxTarget == "" {
+		sink, err := net.ListenPacket("udp", "127.0.0.1:0")
+		if err != nil {
+			fmt.Println("Error:", err)
+			return 1
+		}
+		defer sink.Close()
+		go func() {
+			buf := make([]byte, 64<<10)
+			for {
+				if _, _, err := sink.ReadFrom(buf); err != nil {
+					return
+				}
+			}
+		}()
+		if statsdTarget == "" {
+			statsdTarget = sink.LocalAddr().String()
+		}
+		if influxTarget == "" {
+			influxTarget = "udp://" + sink.LocalAddr().String()
+		}
+	}
+
+	for _, target := range []struct {
+		name, addr string
+		format     func([]byte, *sample) []byte
+	}{
+		{"statsd", statsdTarget, appendStatsD},
+		{"influx", influxTarget, appendInflux},
+	} {
+		if target.addr == "" {
+			continue
+		}
+		e, err := newEmitter(target.name, target.addr, target.format)
+		if err != nil {
+			fmt.Println("Error:", err)
+			return 1
+		}
+		emitters = append(emitters, e)
+	}
+	r, err := startRecorder(recordDir, int64(recordMaxSizeMB)<<20)
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	sessionRecorder = r
+	sessionProfile = newEnergyProfile()
+
+	done := make(chan struct{})
+	samples := make(chan *sample)
+	go collectMetrics(done, samples, newSamplePool(8, 16, 512), model)
+
+	target := time.Duration(hours * float64(time.Hour))
+	warmupEnd := time.Duration(warmup * float64(target))
+	var simulated time.Duration
+	var count int
+	var failures []string
+	var base *soakStats
+	start := time.Now()
+	check := time.NewTicker(checkEvery)
+	defer check.Stop()
+	report := func() soakStats {
+		st := readSoakStats()
+		v := st.violations(limits)
+		fmt.Printf("%7.2fh simulated %8d samples %6.0fx | heap %6.1f MB  rss %6.1f MB  goroutines %3d  fds %3d  names %5d  sparklines %2d  profile %5d  history %6d  power buffer %3d\n",
+			simulated.Hours(), count, float64(simulated)/float64(time.Since(start)),
+			st.heapMB, st.rssMB, st.goroutines, st.fds, st.processes, st.procHistory, st.profile, st.history, st.powerValues)
+		if len(v) > 0 {
+			fmt.Println("        FAIL:", strings.Join(v, ", "))
+		}
+		failures = append(failures, v...)
+		return st
+	}
+	for simulated < target {
+		if base == nil && simulated >= warmupEnd {
+			runtime.GC()
+			st := report()
+			base = &st
+			fmt.Println("        warm-up done; growth from here on is checked at the end")
+		}
+		select {
+		case s := <-samples:
+			updateCPUUI(s.CPU)
+			updateTotalPowerChart(s.CPU.PackageW)
+			updateGPUUI(s.GPU)
+			updateNetDiskUI(s.NetDisk)
+			updateProcessUI(s.Processes)
+			s.release()
+			simulated = vclock.Now().Sub(simStart)
+			count++
+		case <-sched.C:
+			sched.fire()
+		case <-check.C:
+			report()
+		}
+	}
+	// Measure with everything still running, as at the end of the warm-up.
+	runtime.GC()
+	end := report()
+	if base != nil {
+		if v := end.growth(*base); len(v) > 0 {
+			fmt.Println("        FAIL:", strings.Join(v, ", "))
+			failures = append(failures, v...)
+		}
+	}
+	achieved := float64(simulated) / float64(time.Since(start))
+	if achieved < 0.9*speed {
+		fmt.Printf("        speed shortfall: ran at %.0fx of the %.0fx asked for\n", achieved, speed)
+	}
+
+	close(done)
+	sessionRecorder.close()
+	for _, e := range emitters {
+		e.close()
+	}
+	if err := sessionProfile.write(pprofPath, sessionClock.Now()); err != nil {
+		fmt.Println("Error: writing the energy profile:", err)
+	}
+	if len(failures) > 0 {
+		fmt.Printf("soak failed: %d violations\n", len(failures))
+		return 1
+	}
+	fmt.Printf("soak passed at %.0fx\n", achieved)
+	return 0
+}
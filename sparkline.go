@@ -0,0 +1,163 @@
+package main
+
+import "strings"
+
+// procHistory keeps a short CPU, GPU and energy history for the processes
+// in the process table, and for a bounded set that recently dropped out of
+// it, so a process that comes back still shows where it has been. Rings
+// come from a slab allocated up front and are recycled when a process is
+// forgotten, so the table's churn does not allocate.
+const (
+	procHistoryLen = 24 // samples per ring, one sparkline cell each
+	procTableRows  = 15
+	procRecentMax  = 32
+)
+
+type procKey struct {
+	pid  int
+	name string
+}
+
+type procRing struct {
+	cpu, gpu, energy [procHistoryLen]float32
+	head, n          int
+	seen             uint64 // sample number of the last push
+}
+
+func (r *procRing) push(pm ProcessMetrics) {
+	r.cpu[r.head] = float32(pm.CPUUsage)
+	r.gpu[r.head] = float32(pm.GPUUsage)
+	r.energy[r.head] = float32(pm.EnergyImpact)
+	r.head = (r.head + 1) % procHistoryLen
+	if r.n < procHistoryLen {
+		r.n++
+	}
+}
+
+type procHistory struct {
+	slab    []procRing
+	free    []int
+	tracked map[procKey]int // slab index, for table rows and recent ones
+	inTable map[procKey]bool
+	prev    map[procKey]bool // inTable as of the previous sample
+	recent  []procKey        // dropped out of the table, oldest first
+	samples uint64
+}
+
+var processHistory = newProcHistory(procTableRows + procRecentMax)
+
+func newProcHistory(size int) *procHistory {
+	h := &procHistory{
+		slab:    make([]procRing, size),
+		free:    make([]int, size),
+		tracked: make(map[procKey]int, size),
+		inTable: make(map[procKey]bool, procTableRows),
+		prev:    make(map[procKey]bool, procTableRows),
+	}
+	for i := range h.free {
+		h.free[i] = size - 1 - i
+	}
+	return h
+}
+
+// update records one sample. procs is sorted, highest CPU first, and its
+// first rows entries are the process table.
+func (h *procHistory) update(procs []ProcessMetrics, rows int) {
+	h.samples++
+	if len(procs) < rows {
+		rows = len(procs)
+	}
+	h.prev, h.inTable = h.inTable, h.prev
+	for k := range h.inTable {
+		delete(h.inTable, k)
+	}
+	for _, pm := range procs[:rows] {
+		h.inTable[procKey{pm.ID, pm.Name}] = true
+	}
+	for k := range h.prev {
+		if !h.inTable[k] {
+			h.recent = append(h.recent, k)
+		}
+	}
+	kept := h.recent[:0]
+	for _, k := range h.recent {
+		if !h.inTable[k] {
+			kept = append(kept, k)
+		}
+	}
+	h.recent = kept
+	for k := range h.inTable {
+		if _, ok := h.tracked[k]; !ok {
+			h.track(k)
+		}
+	}
+	for len(h.recent) > procRecentMax {
+		h.forgetOldest()
+	}
+
+	// Recently dropped processes keep recording while they run; absent
+	// ones record zero.
+	for _, pm := range procs {
+		if i, ok := h.tracked[procKey{pm.ID, pm.Name}]; ok && h.slab[i].seen != h.samples {
+			h.slab[i].push(pm)
+			h.slab[i].seen = h.samples
+		}
+	}
+	for _, i := range h.tracked {
+		if h.slab[i].seen != h.samples {
+			h.slab[i].push(ProcessMetrics{})
+			h.slab[i].seen = h.samples
+		}
+	}
+}
+
+func (h *procHistory) track(k procKey) {
+	if len(h.free) == 0 {
+		h.forgetOldest() // the slab holds every row, so recent is not empty
+	}
+	i := h.free[len(h.free)-1]
+	h.free = h.free[:len(h.free)-1]
+	h.slab[i] = procRing{}
+	h.tracked[k] = i
+}
+
+// forgetOldest recycles the ring of the process that left the table first.
+func (h *procHistory) forgetOldest() {
+	k := h.recent[0]
+	h.recent = h.recent[:copy(h.recent, h.recent[1:])]
+	if i, ok := h.tracked[k]; ok {
+		delete(h.tracked, k)
+		h.free = append(h.free, i)
+	}
+}
+
+// sparkline renders a process's CPU history, oldest first, scaled to its
+// own peak and padded on the left while the history is short.
+func (h *procHistory) sparkline(k procKey) string {
+	i, ok := h.tracked[k]
+	if !ok {
+		return ""
+	}
+	r := &h.slab[i]
+	var peak float32
+	for _, v := range r.cpu[:r.n] {
+		if v > peak {
+			peak = v
+		}
+	}
+	var sb strings.Builder
+	for j := r.n; j < procHistoryLen; j++ {
+		sb.WriteByte(' ')
+	}
+	for j := 0; j < r.n; j++ {
+		v := r.cpu[(r.head-r.n+j+procHistoryLen)%procHistoryLen]
+		level := 0
+		if peak > 0 {
+			level = int(v / peak * float32(len(sparkLevels)-1))
+		}
+		sb.WriteRune(sparkLevels[level])
+	}
+	return sb.String()
+}
+
+var sparkLevels = []rune("▁▂▃▄▅▆▇█")
@@ -0,0 +1,151 @@
+package main
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"os"
+	"os/exec"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// startupBegin approximates process start: package variables are
+// initialized before main runs.
+var startupBegin = time.Now()
+
+// startupTrace records how long each startup phase took, from argument
+// parsing to the first frame that shows real data. It is wall-clock time on
+// purpose; the session clock may be virtual.
+var startupTrace = &startTrace{}
+
+// startupReport makes mactop exit after its first data frame and print the
+// trace, for `mactop --startup-report` and `mactop bench-startup`.
+var startupReport bool
+
+type startPhase struct {
+	name       string
+	start, dur time.Duration // offset from startupBegin, length
+}
+
+type startTrace struct {
+	mu       sync.Mutex
+	phases   []startPhase
+	finished bool
+}
+
+// phase records a phase that began at start and ends now. Use it as
+//
+//	defer startupTrace.phase("name", time.Now())
+//
+// Phases after the first data frame are ignored, so code shared with later
+// work can stay instrumented.
+func (t *startTrace) phase(name string, start time.Time) {
+	end := time.Now()
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if !t.finished {
+		t.phases = append(t.phases, startPhase{name, start.Sub(startupBegin), end.Sub(start)})
+	}
+}
+
+// milestone records a point in time, such as the first sample, as a phase
+// spanning from process start.
+func (t *startTrace) milestone(name string) {
+	t.phase(name, startupBegin)
+}
+
+// finish closes the trace after the first data frame and logs it.
+func (t *startTrace) finish() {
+	t.milestone("first data frame")
+	t.mu.Lock()
+	t.finished = true
+	t.mu.Unlock()
+	var sb strings.Builder
+	t.write(&sb)
+	stderrLogger.Printf("startup trace:\n%s", sb.String())
+}
+
+func (t *startTrace) write(out io.Writer) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	for _, p := range t.phases {
+		fmt.Fprintf(out, "%-34s  %9.1f ms  done at %9.1f ms\n", p.name, millis(p.dur), millis(p.start+p.dur))
+	}
+}
+
+func millis(d time.Duration) float64 {
+	return float64(d) / float64(time.Millisecond)
+}
+
+// runBenchStartup implements `mactop bench-startup`: it runs
+// `mactop --startup-report` repeatedly and prints the min, median and max of
+// every phase. Put stubs for powermetrics, sysctl and system_profiler first
+// on PATH (see cmd/fake-powermetrics) to measure mactop's own cost rather
+// than the tools'. It needs root and a terminal, like mactop itself.
+func runBenchStartup(args []string) int {
+	runs := 10
+	var extra []string
+	for i := 0; i < len(args); i++ {
+		switch {
+		case args[i] == "--runs" && i+1 < len(args):
+			n, err := strconv.Atoi(args[i+1])
+			if err != nil || n <= 0 {
+				fmt.Printf("Error: invalid --runs %q\n", args[i+1])
+				return 1
+			}
+			runs = n
+			i++
+		case args[i] == "--":
+			extra = args[i+1:]
+			i = len(args)
+		default:
+			fmt.Println("Usage: mactop bench-startup [--runs 10] [-- mactop flags]")
+			return 1
+		}
+	}
+	self, err := os.Executable()
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	// The terminal UI draws on /dev/tty, so stdout carries only the report.
+	cmdArgs := append([]string{"--startup-report", "--graphics", "off"}, extra...)
+	durations := map[string][]float64{}
+	var order []string
+	for i := 0; i < runs; i++ {
+		var out bytes.Buffer
+		cmd := exec.Command(self, cmdArgs...)
+		cmd.Stdin, cmd.Stdout, cmd.Stderr = os.Stdin, &out, os.Stderr
+		if err := cmd.Run(); err != nil {
+			fmt.Printf("Error: run %d: %v\n", i+1, err)
+			return 1
+		}
+		for _, line := range strings.Split(out.String(), "\n") {
+			name, rest, ok := strings.Cut(line, "  ")
+			name = strings.TrimSpace(name)
+			fields := strings.Fields(rest)
+			if !ok || len(fields) < 2 || fields[1] != "ms" {
+				continue
+			}
+			v, err := strconv.ParseFloat(fields[0], 64)
+			if err != nil {
+				continue
+			}
+			if _, seen := durations[name]; !seen {
+				order = append(order, name)
+			}
+			durations[name] = append(durations[name], v)
+		}
+	}
+	fmt.Printf("%d runs\n%-34s %9s %9s %9s\n", runs, "phase (ms)", "min", "median", "max")
+	for _, name := range order {
+		v := durations[name]
+		sort.Float64s(v)
+		fmt.Printf("%-34s %9.1f %9.1f %9.1f\n", name, v[0], v[len(v)/2], v[len(v)-1])
+	}
+	return 0
+}
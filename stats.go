@@ -0,0 +1,248 @@
+package main
+
+import (
+	"math"
+	"time"
+)
+
+// quantileSketch is a fixed-size log-bucketed histogram. Each bucket spans a
+// factor of sketchGamma, so quantiles are accurate to about 1% relative error
+// and adding a value is O(1) no matter how long the session runs.
+//
+// The buckets cover 1e-3 to about 4e14, which holds every metric: watts,
+// percentages, MHz, thermal levels, and memory and swap in bytes up to
+// hundreds of terabytes. Larger values are clamped into the last bucket.
+const (
+	sketchGamma   = 1.02
+	sketchMin     = 1e-3 // values at or below this land in the zero bucket
+	sketchBuckets = 2048 // covers sketchMin up to ~4e14
+)
+
+var sketchLogGamma = math.Log(sketchGamma)
+
+type quantileSketch struct {
+	zero   uint64
+	counts [sketchBuckets]uint64
+	total  uint64
+}
+
+func (q *quantileSketch) add(v float64) {
+	q.total++
+	if v <= sketchMin {
+		q.zero++
+		return
+	}
+	i := int(math.Ceil(math.Log(v/sketchMin) / sketchLogGamma))
+	if i >= sketchBuckets {
+		i = sketchBuckets - 1
+	}
+	q.counts[i]++
+}
+
+func (q *quantileSketch) merge(o *quantileSketch) {
+	q.zero += o.zero
+	q.total += o.total
+	for i := range q.counts {
+		q.counts[i] += o.counts[i]
+	}
+}
+
+// quantile returns the estimated p-th percentile (0-100).
+func (q *quantileSketch) quantile(p float64) float64 {
+	if q.total == 0 {
+		return 0
+	}
+	rank := uint64(math.Ceil(p / 100 * float64(q.total)))
+	if rank == 0 {
+		rank = 1
+	}
+	seen := q.zero
+	if seen >= rank {
+		return 0
+	}
+	for i, c := range q.counts {
+		seen += c
+		if seen >= rank {
+			// Midpoint of the bucket (sketchMin*gamma^(i-1), sketchMin*gamma^i].
+			return sketchMin * math.Pow(sketchGamma, float64(i)) * 2 / (1 + sketchGamma)
+		}
+	}
+	return sketchMin * math.Pow(sketchGamma, sketchBuckets)
+}
+
+// runningStat accumulates count, mean, extremes and quantiles of a metric.
+type runningStat struct {
+	Count    int
+	Sum      float64
+	Min, Max float64
+	sketch   quantileSketch
+}
+
+func (r *runningStat) add(v float64) {
+	if r.Count == 0 || v < r.Min {
+		r.Min = v
+	}
+	if r.Count == 0 || v > r.Max {
+		r.Max = v
+	}
+	r.Count++
+	r.Sum += v
+	r.sketch.add(v)
+}
+
+func (r *runningStat) merge(o *runningStat) {
+	if o.Count == 0 {
+		return
+	}
+	if r.Count == 0 || o.Min < r.Min {
+		r.Min = o.Min
+	}
+	if r.Count == 0 || o.Max > r.Max {
+		r.Max = o.Max
+	}
+	r.Count += o.Count
+	r.Sum += o.Sum
+	r.sketch.merge(&o.sketch)
+}
+
+func (r *runningStat) mean() float64 {
+	if r.Count == 0 {
+		return 0
+	}
+	return r.Sum / float64(r.Count)
+}
+
+// quantile clamps the sketch estimate to the exact observed extremes.
+func (r *runningStat) quantile(p float64) float64 {
+	return math.Max(r.Min, math.Min(r.Max, r.sketch.quantile(p)))
+}
+
+// Frequency domains tracked for time-at-frequency.
+const (
+	freqDomainE = iota
+	freqDomainP
+	freqDomainGPU
+	numFreqDomains
+)
+
+var (
+	freqDomainNames   = [numFreqDomains]string{"E-Cluster", "P-Cluster", "GPU"}
+	freqDomainMetrics = [numFreqDomains]metricID{metricEClusterFreqMHz, metricPClusterFreqMHz, metricGPUFreqMHz}
+)
+
+const freqBucketMHz = 100
+
+// Per-process totals are kept by these weights, each in its own sketch.
+type procWeight int
+
+const (
+	procCPUMs procWeight = iota
+	procGPUMs
+	procEnergy
+	numProcWeights
+)
+
+var procWeightNames = [numProcWeights]string{"cpu_ms", "gpu_ms", "energy_impact"}
+
+func (w procWeight) of(pm *ProcessMetrics) float64 {
+	switch w {
+	case procCPUMs:
+		return pm.CPUUsage
+	case procGPUMs:
+		return pm.GPUUsage
+	default:
+		return pm.EnergyImpact
+	}
+}
+
+// procSketches tracks the heaviest processes by name for every weight, in
+// fixed memory however many processes come and go. Keying by name rather
+// than by pid adds up the instances of one program, as the summary's
+// process totals always have: a build's thousands of short-lived clang
+// processes rank as one clang, and a restarted daemon keeps its total.
+// Per-pid accounting, with ancestry, is what --pprof is for.
+type procSketches [numProcWeights]*spaceSaving
+
+func newProcSketches(halfLife time.Duration) procSketches {
+	var p procSketches
+	for w := range p {
+		p[w] = newSpaceSaving(heavyHitterCap, halfLife)
+	}
+	return p
+}
+
+func (p procSketches) observe(s *sample) {
+	for i := range s.Processes {
+		pm := &s.Processes[i]
+		for w, sk := range p {
+			sk.add(pm.Name, procWeight(w).of(pm)*s.Elapsed, s.Time)
+		}
+	}
+}
+
+// tracked is the number of distinct names held, at most heavyHitterCap per
+// weight.
+func (p procSketches) tracked() int {
+	n := 0
+	for _, sk := range p {
+		if sk.len() > n {
+			n = sk.len()
+		}
+	}
+	return n
+}
+
+// accumulator folds samples into session-style totals: energy per rail,
+// running stats for every metric, time at each frequency, time spent under
+// thermal pressure and cumulative per-process usage. Each observe is O(1)
+// in the number of samples seen so far.
+type accumulator struct {
+	Samples    int
+	Elapsed    float64 // seconds of powermetrics samples covered
+	EnergyJ    [numMetrics]float64
+	Stats      [numMetrics]runningStat
+	ThrottledS float64
+	FreqTimeS  [numFreqDomains]map[int]float64 // seconds per freqBucketMHz bucket
+	Procs      procSketches
+}
+
+func newAccumulator() *accumulator {
+	a := &accumulator{Procs: newProcSketches(0)}
+	for i := range a.FreqTimeS {
+		a.FreqTimeS[i] = make(map[int]float64)
+	}
+	return a
+}
+
+func (a *accumulator) observe(s *sample) {
+	a.Samples++
+	a.Elapsed += s.Elapsed
+	for _, rail := range powerRails {
+		a.EnergyJ[rail] += s.Values[rail] * s.Elapsed
+	}
+	for i := range a.Stats {
+		a.Stats[i].add(s.Values[i])
+	}
+	if s.Values[metricThermalPressure] > 0 {
+		a.ThrottledS += s.Elapsed
+	}
+	for d, m := range freqDomainMetrics {
+		if mhz := s.Values[m]; mhz > 0 {
+			a.FreqTimeS[d][int(math.Round(mhz/freqBucketMHz))*freqBucketMHz] += s.Elapsed
+		}
+	}
+	a.Procs.observe(s)
+}
+
+// processTotal is a process's total by one weight. Totals come from a
+// heavy-hitters sketch and may overstate the true total by up to Error.
+type processTotal struct {
+	Name  string  `json:"name"`
+	Value float64 `json:"value"`
+	Error float64 `json:"error,omitempty"`
+}
+
+// topProcesses returns the n processes with the largest totals by w.
+func (a *accumulator) topProcesses(n int, w procWeight) []processTotal {
+	return a.Procs[w].top(n, time.Time{})
+}
@@ -0,0 +1,154 @@
+package main
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"os"
+	"sort"
+	"strconv"
+	"sync"
+	"time"
+)
+
+// sessionTotals accumulates the whole session for the exit summary. recent
+// keeps the heaviest processes over a decayed window, so a long session
+// still shows what has been busy lately.
+var sessionTotals = struct {
+	sync.Mutex
+	start  time.Time
+	acc    *accumulator
+	recent procSketches
+}{start: sessionClock.Now(), acc: newAccumulator(), recent: newProcSketches(heavyHitterHalfLife)}
+
+func observeSession(s *sample) {
+	sessionTotals.Lock()
+	sessionTotals.acc.observe(s)
+	sessionTotals.recent.observe(s)
+	sessionTotals.Unlock()
+}
+
+type metricSummary struct {
+	Mean float64 `json:"mean"`
+	P95  float64 `json:"p95"`
+	Max  float64 `json:"max"`
+}
+
+type sessionSummary struct {
+	Start             time.Time                     `json:"start"`
+	End               time.Time                     `json:"end"`
+	DurationS         float64                       `json:"duration_s"`
+	Samples           int                           `json:"samples"`
+	EnergyJ           map[string]float64            `json:"energy_j"`
+	Metrics           map[string]metricSummary      `json:"metrics"`
+	TimeAtFrequencyS  map[string]map[string]float64 `json:"time_at_frequency_s"`
+	ThrottledS        float64                       `json:"throttled_s"`
+	PeakMemUsedBytes  uint64                        `json:"peak_mem_used_bytes"`
+	PeakSwapUsedBytes uint64                        `json:"peak_swap_used_bytes"`
+	TopCPUMs          []processTotal                `json:"top_cpu_ms"`
+	TopGPUMs          []processTotal                `json:"top_gpu_ms"`
+	TopEnergy         []processTotal                `json:"top_energy_impact"`
+	RecentTop         map[string][]processTotal     `json:"recent_top,omitempty"`
+}
+
+func summarize(start, end time.Time, a *accumulator) sessionSummary {
+	s := sessionSummary{
+		Start:             start,
+		End:               end,
+		DurationS:         end.Sub(start).Seconds(),
+		Samples:           a.Samples,
+		EnergyJ:           make(map[string]float64),
+		Metrics:           make(map[string]metricSummary),
+		TimeAtFrequencyS:  make(map[string]map[string]float64),
+		ThrottledS:        a.ThrottledS,
+		PeakMemUsedBytes:  uint64(a.Stats[metricMemUsed].Max),
+		PeakSwapUsedBytes: uint64(a.Stats[metricSwapUsed].Max),
+		TopCPUMs:          a.topProcesses(10, procCPUMs),
+		TopGPUMs:          a.topProcesses(10, procGPUMs),
+		TopEnergy:         a.topProcesses(10, procEnergy),
+	}
+	for _, rail := range powerRails {
+		s.EnergyJ[metricNames[rail]] = a.EnergyJ[rail]
+	}
+	for i := range a.Stats {
+		st := &a.Stats[i]
+		s.Metrics[metricNames[i]] = metricSummary{Mean: st.mean(), P95: st.quantile(95), Max: st.Max}
+	}
+	for d, buckets := range a.FreqTimeS {
+		m := make(map[string]float64, len(buckets))
+		for mhz, secs := range buckets {
+			m[strconv.Itoa(mhz)] = secs
+		}
+		s.TimeAtFrequencyS[freqDomainNames[d]] = m
+	}
+	return s
+}
+
+func currentSessionSummary() sessionSummary {
+	sessionTotals.Lock()
+	defer sessionTotals.Unlock()
+	now := sessionClock.Now()
+	s := summarize(sessionTotals.start, now, sessionTotals.acc)
+	s.RecentTop = make(map[string][]processTotal, numProcWeights)
+	for w, sk := range sessionTotals.recent {
+		s.RecentTop[procWeightNames[w]] = sk.top(10, now)
+	}
+	return s
+}
+
+func (s sessionSummary) writeText(out io.Writer) {
+	fmt.Fprintf(out, "mactop session: %s, %d samples\n", time.Duration(s.DurationS*float64(time.Second)).Round(time.Second), s.Samples)
+	fmt.Fprintf(out, "Energy: package %.1f J, CPU %.1f J, GPU %.1f J, ANE %.1f J\n",
+		s.EnergyJ["PackageW"], s.EnergyJ["CPUW"], s.EnergyJ["GPUW"], s.EnergyJ["ANEW"])
+	fmt.Fprintf(out, "%-18s %10s %10s %10s\n", "metric", "mean", "p95", "max")
+	for _, name := range metricNames {
+		m := s.Metrics[name]
+		fmt.Fprintf(out, "%-18s %10.2f %10.2f %10.2f\n", name, m.Mean, m.P95, m.Max)
+	}
+	for _, domain := range freqDomainNames {
+		buckets := s.TimeAtFrequencyS[domain]
+		mhz := make([]int, 0, len(buckets))
+		for k := range buckets {
+			v, _ := strconv.Atoi(k)
+			mhz = append(mhz, v)
+		}
+		sort.Ints(mhz)
+		fmt.Fprintf(out, "Time at frequency, %s:", domain)
+		for _, f := range mhz {
+			fmt.Fprintf(out, " %d MHz %.0fs;", f, buckets[strconv.Itoa(f)])
+		}
+		fmt.Fprintln(out)
+	}
+	fmt.Fprintf(out, "Thermal pressure above nominal: %.0f s\n", s.ThrottledS)
+	fmt.Fprintf(out, "Peak memory: %.2f GB, peak swap: %.2f GB\n", float64(s.PeakMemUsedBytes)/1024/1024/1024, float64(s.PeakSwapUsedBytes)/1024/1024/1024)
+	for _, top := range []struct {
+		title string
+		procs []processTotal
+	}{
+		{"Top CPU (ms)", s.TopCPUMs},
+		{"Top GPU (ms)", s.TopGPUMs},
+		{"Top energy impact", s.TopEnergy},
+		{fmt.Sprintf("Top energy impact, last %v half-life", heavyHitterHalfLife), s.RecentTop["energy_impact"]},
+	} {
+		fmt.Fprintf(out, "%s:", top.title)
+		for i, p := range top.procs {
+			if i == 5 {
+				break
+			}
+			fmt.Fprintf(out, " %s %.0f", p.Name, p.Value)
+			if p.Error > 0 {
+				fmt.Fprintf(out, " (≤%.0f over)", p.Error)
+			}
+			fmt.Fprint(out, ";")
+		}
+		fmt.Fprintln(out)
+	}
+}
+
+func writeSummaryJSON(path string, s sessionSummary) error {
+	data, err := json.MarshalIndent(s, "", "  ")
+	if err != nil {
+		return err
+	}
+	return os.WriteFile(path, append(data, '\n'), 0644)
+}
@@ -0,0 +1,297 @@
+package main
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"sort"
+	"strconv"
+	"time"
+)
+
+// Sessions can be written as Chrome trace events in the JSON array format,
+// which Perfetto and chrome://tracing open alongside application traces.
+// Every metric is a counter track, markers are global instant events and,
+// live, the busiest processes get counter tracks of their own. Timestamps
+// are Unix microseconds, so the tracks line up with other traces taken
+// against the wall clock.
+//
+// Events are written as they arrive, one per line. The closing bracket is
+// optional in the array format, so a live trace cut short still opens.
+const (
+	tracePidSystem    = 1
+	tracePidProcesses = 2
+	traceTopProcesses = 5
+)
+
+var traceOutPath string
+
+// appendTraceHeader starts a trace with the track names. Every later event
+// is appended with a leading comma.
+func appendTraceHeader(b []byte) []byte {
+	b = append(b, `[{"name":"process_name","ph":"M","pid":1,"args":{"name":"mactop"}}`...)
+	b = append(b, ",\n"...)
+	b = append(b, `{"name":"process_name","ph":"M","pid":2,"args":{"name":"mactop processes"}}`...)
+	return b
+}
+
+func appendTraceCounter(b []byte, pid int, name string, t time.Time, v float64) []byte {
+	if math.IsNaN(v) || math.IsInf(v, 0) {
+		return b
+	}
+	b = append(b, ",\n{\"name\":"...)
+	b = appendJSONString(b, name)
+	b = append(b, `,"ph":"C","pid":`...)
+	b = strconv.AppendInt(b, int64(pid), 10)
+	b = append(b, `,"ts":`...)
+	b = strconv.AppendInt(b, t.UnixMicro(), 10)
+	b = append(b, `,"args":{"value":`...)
+	b = strconv.AppendFloat(b, v, 'f', -1, 64)
+	return append(b, "}}"...)
+}
+
+func appendTraceInstant(b []byte, m marker) []byte {
+	b = append(b, ",\n{\"name\":"...)
+	b = appendJSONString(b, m.Label)
+	b = append(b, `,"ph":"i","s":"g","pid":1,"tid":0,"ts":`...)
+	b = strconv.AppendInt(b, m.Time.UnixMicro(), 10)
+	return append(b, '}')
+}
+
+func appendJSONString(b []byte, s string) []byte {
+	q, _ := json.Marshal(s)
+	return append(b, q...)
+}
+
+// traceFormatter formats live samples for an emitter, with the markers
+// added since the previous sample and the top processes by CPU. A process
+// that leaves the top gets a final zero, so its track does not hold its
+// last value.
+type traceFormatter struct {
+	last  time.Time
+	shown map[string]bool
+	names map[string]string // process name to track name
+	top   []ProcessMetrics
+}
+
+func newTraceFormatter() *traceFormatter {
+	return &traceFormatter{shown: make(map[string]bool), names: make(map[string]string)}
+}
+
+func (f *traceFormatter) format(b []byte, s *sample) []byte {
+	for i, v := range s.Values {
+		b = appendTraceCounter(b, tracePidSystem, metricNames[i], s.Time, v)
+	}
+	for _, m := range sessionMarkers.between(f.last, s.Time) {
+		b = appendTraceInstant(b, m)
+	}
+	f.last = s.Time
+
+	f.top = append(f.top[:0], s.Processes...)
+	sort.Slice(f.top, func(i, j int) bool { return f.top[i].CPUUsage > f.top[j].CPUUsage })
+	if len(f.top) > traceTopProcesses {
+		f.top = f.top[:traceTopProcesses]
+	}
+	for name := range f.shown {
+		f.shown[name] = false
+	}
+	for _, pm := range f.top {
+		b = appendTraceCounter(b, tracePidProcesses, f.track(pm.Name), s.Time, pm.CPUUsage)
+		f.shown[pm.Name] = true
+	}
+	for name, still := range f.shown {
+		if !still {
+			b = appendTraceCounter(b, tracePidProcesses, f.track(name), s.Time, 0)
+			delete(f.shown, name)
+			delete(f.names, name)
+		}
+	}
+	return b
+}
+
+func (f *traceFormatter) track(name string) string {
+	t, ok := f.names[name]
+	if !ok {
+		t = "CPU ms/s " + name
+		f.names[name] = t
+	}
+	return t
+}
+
+// startTraceFile creates the live trace file, replacing any old one, and
+// returns an emitter that appends samples to it.
+func startTraceFile(path string) (*emitter, error) {
+	if err := os.WriteFile(path, appendTraceHeader(nil), 0644); err != nil {
+		return nil, err
+	}
+	return newEmitter("trace", path, newTraceFormatter().format)
+}
+
+// finishTraceFile closes the live trace's array once its emitter has stopped.
+func finishTraceFile(path string) {
+	f, err := os.OpenFile(path, os.O_WRONLY|os.O_APPEND, 0644)
+	if err != nil {
+		return
+	}
+	f.WriteString("\n]\n")
+	f.Close()
+}
+
+// runExport implements `mactop export --trace <recording> <out.json>`. It
+// reads one block at a time, so the size of the recording does not matter.
+// Where retention has dropped raw samples, the 1-minute rollup means are
+// written instead.
+func runExport(args []string) int {
+	usage := func() int {
+		fmt.Println("Usage: mactop export --trace <recording> <out.json|-> [--from T] [--to T]")
+		return 1
+	}
+	var paths []string
+	var fromArg, toArg string
+	trace := false
+	for i := 0; i < len(args); i++ {
+		switch {
+		case args[i] == "--trace":
+			trace = true
+		case (args[i] == "--from" || args[i] == "--to") && i+1 < len(args):
+			if args[i] == "--from" {
+				fromArg = args[i+1]
+			} else {
+				toArg = args[i+1]
+			}
+			i++
+		case len(args[i]) > 1 && args[i][0] == '-':
+			fmt.Println("Error: unexpected argument", args[i])
+			return usage()
+		default:
+			paths = append(paths, args[i])
+		}
+	}
+	if !trace || len(paths) != 2 {
+		return usage()
+	}
+	segs, first, last, err := openRecording(paths[0])
+	if err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	now := time.Now()
+	lo, hi := first, last
+	if fromArg != "" {
+		t, err := parseQueryTime(fromArg, now)
+		if err != nil {
+			fmt.Println("Error: invalid --from:", err)
+			return 1
+		}
+		lo = t.UnixNano()
+	}
+	if toArg != "" {
+		t, err := parseQueryTime(toArg, now)
+		if err != nil {
+			fmt.Println("Error: invalid --to:", err)
+			return 1
+		}
+		hi = t.UnixNano()
+	}
+
+	var out io.Writer = os.Stdout
+	if paths[1] != "-" {
+		f, err := os.Create(paths[1])
+		if err != nil {
+			fmt.Println("Error:", err)
+			return 1
+		}
+		defer f.Close()
+		out = f
+	}
+	w := bufio.NewWriterSize(out, 1<<16)
+	if err := exportTrace(w, segs, lo, hi); err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	if err := w.Flush(); err != nil {
+		fmt.Println("Error:", err)
+		return 1
+	}
+	return 0
+}
+
+func exportTrace(w io.Writer, segs []*segmentReader, lo, hi int64) error {
+	b := appendTraceHeader(nil)
+	flush := func() error {
+		_, err := w.Write(b)
+		b = b[:0]
+		return err
+	}
+	for _, r := range segs {
+		f, err := os.Open(r.path)
+		if err != nil {
+			return err
+		}
+		kind := blockRaw
+		blocks := r.blocks(blockRaw, lo, hi)
+		if len(blocks) == 0 {
+			kind, blocks = blockRollup1m, r.blocks(blockRollup1m, lo, hi)
+		}
+		blocks = append(blocks, r.blocks(blockMarkers, lo, hi)...)
+		for _, e := range blocks {
+			h, payload, err := r.readBlock(f, e)
+			if err != nil {
+				fmt.Fprintf(os.Stderr, "Warning: %s at offset %d: %v\n", r.path, e.Offset, err)
+				continue
+			}
+			switch {
+			case h.Kind == blockMarkers:
+				markers, err := decodeMarkers(int(h.Count), payload)
+				if err != nil {
+					f.Close()
+					return err
+				}
+				for _, m := range markers {
+					if ts := m.Time.UnixNano(); ts >= lo && ts <= hi {
+						b = appendTraceInstant(b, m)
+					}
+				}
+			case kind == blockRaw:
+				times, _, cols, err := r.decodeRaw(int(h.Count), payload)
+				if err != nil {
+					f.Close()
+					return err
+				}
+				for j, ts := range times {
+					if ts < lo || ts > hi {
+						continue
+					}
+					for c, name := range r.metrics {
+						b = appendTraceCounter(b, tracePidSystem, name, time.Unix(0, ts), cols[c][j])
+					}
+				}
+			default:
+				buckets, err := r.decodeRollups(int(h.Count), payload)
+				if err != nil {
+					f.Close()
+					return err
+				}
+				for j := range buckets {
+					bk := &buckets[j]
+					if bk.N == 0 || bk.Start < lo || bk.Start > hi {
+						continue
+					}
+					for id, name := range metricNames {
+						b = appendTraceCounter(b, tracePidSystem, name, time.Unix(0, bk.Start), bk.Sum[id]/float64(bk.N))
+					}
+				}
+			}
+			if err := flush(); err != nil {
+				f.Close()
+				return err
+			}
+		}
+		f.Close()
+	}
+	b = append(b, "\n]\n"...)
+	return flush()
+}